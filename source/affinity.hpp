@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <limits>
+
+// Tasks created with the same affinity key prefer to run on the same worker of the arena
+// they are pushed to, so the data they share stays in the cache of one core.
+struct Affinity
+{
+	static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+	size_t key = NONE;
+};
+
+template<typename Key>
+Affinity makeAffinity(const Key& key)
+{
+	auto hash = std::hash<Key>{}(key);
+	return Affinity{ hash == Affinity::NONE ? hash - 1 : hash };
+}
@@ -0,0 +1,265 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "config.hpp"
+#include "task_factory.hpp"
+#include "task_executor.hpp"
+
+// Parallel versions of a few standard algorithms. The range is split into blocks which fit
+// into half of the L2 cache, but into at least four blocks per worker when the range is large
+// enough; small ranges are processed on the calling thread. Every call blocks the caller until
+// the work is done, so it must not be called from a job running on the same executor.
+
+namespace Detail
+{
+	inline constexpr size_t MIN_GRAIN_SIZE = 1024;
+	inline constexpr size_t BLOCKS_PER_WORKER = 4;
+
+	template<typename ValueType>
+	size_t getGrainSize(size_t count, std::uint16_t threadCount)
+	{
+		const size_t cacheGrain = std::max<size_t>(L2_CACHE_SIZE / 2 / sizeof(ValueType), 1);
+		const size_t balanceGrain = (count + threadCount * BLOCKS_PER_WORKER - 1) / (threadCount * BLOCKS_PER_WORKER);
+		return std::max(std::min(cacheGrain, balanceGrain), MIN_GRAIN_SIZE);
+	}
+
+	// calls body(blockIndex, begin, end) for every block of [0, count) and waits for all of them
+	template<typename Body>
+	void forEachBlock(TaskFactory& factory, TaskExecuter& executor, size_t count, size_t grainSize, const Body& body)
+	{
+		const size_t blockCount = (count + grainSize - 1) / grainSize;
+		if (blockCount <= 1)
+		{
+			if (count != 0)
+			{
+				body(0, 0, count);
+			}
+			return;
+		}
+
+		auto& group = factory.createTaskGroup();
+		group.reserve(blockCount + 1, blockCount);
+
+		const auto join = group.addNode([]() {});
+		for (size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+		{
+			const size_t begin = blockIndex * grainSize;
+			const size_t end = std::min(begin + grainSize, count);
+			const auto node = group.addNode([&body, blockIndex, begin, end]() { body(blockIndex, begin, end); });
+			group.link(node, join);
+		}
+
+		Task<void>(group.getTaskNode(join)).wait(executor);
+	}
+
+	// number of elements taken from the run at left among the first diagonal elements of merging it
+	// with the run at right; ties go to the left run like in std::merge
+	template<typename Iterator, typename Compare>
+	size_t findMergeSplit(Iterator left, size_t leftCount, Iterator right, size_t rightCount, size_t diagonal, Compare& compare)
+	{
+		size_t low = diagonal > rightCount ? diagonal - rightCount : 0;
+		size_t high = std::min(diagonal, leftCount);
+		while (low < high)
+		{
+			const size_t middle = (low + high) / 2;
+			if (compare(right[diagonal - middle - 1], left[middle]))
+			{
+				high = middle;
+			}
+			else
+			{
+				low = middle + 1;
+			}
+		}
+		return low;
+	}
+
+	// merges the neighbouring sorted runs of runSize elements from source into destination;
+	// runSize has to be a multiple of grainSize so that no block spans two merges
+	template<typename SourceIt, typename DestinationIt, typename Compare>
+	void mergeRuns(TaskFactory& factory, TaskExecuter& executor, SourceIt source, DestinationIt destination, size_t count, size_t runSize, size_t grainSize, Compare& compare)
+	{
+		forEachBlock(factory, executor, count, grainSize, [&](size_t, size_t begin, size_t end)
+		{
+			const size_t mergeBegin = begin - begin % (runSize * 2);
+			const size_t middle = std::min(mergeBegin + runSize, count);
+			const size_t mergeEnd = std::min(middle + runSize, count);
+
+			const auto left = source + mergeBegin;
+			const auto right = source + middle;
+			const size_t leftCount = middle - mergeBegin;
+			const size_t rightCount = mergeEnd - middle;
+
+			// the block writes the output positions [begin, end) of the merge
+			const size_t leftBegin = findMergeSplit(left, leftCount, right, rightCount, begin - mergeBegin, compare);
+			const size_t leftEnd = findMergeSplit(left, leftCount, right, rightCount, end - mergeBegin, compare);
+			const size_t rightBegin = begin - mergeBegin - leftBegin;
+			const size_t rightEnd = end - mergeBegin - leftEnd;
+
+			std::merge(std::make_move_iterator(left + leftBegin), std::make_move_iterator(left + leftEnd),
+				std::make_move_iterator(right + rightBegin), std::make_move_iterator(right + rightEnd),
+				destination + begin, compare);
+		});
+	}
+}
+
+template<typename RandomIt, typename ValueType, typename ReduceOperation, typename TransformOperation>
+ValueType parallelTransformReduce(TaskFactory& factory, TaskExecuter& executor, RandomIt first, RandomIt last, ValueType init, ReduceOperation reduce, TransformOperation transform)
+{
+	const size_t count = std::distance(first, last);
+	const size_t grainSize = Detail::getGrainSize<typename std::iterator_traits<RandomIt>::value_type>(count, executor.getThreadCount());
+	const size_t blockCount = (count + grainSize - 1) / grainSize;
+
+	std::vector<ValueType> partials(blockCount, init);
+	Detail::forEachBlock(factory, executor, count, grainSize, [&](size_t blockIndex, size_t begin, size_t end)
+	{
+		auto value = transform(first[begin]);
+		for (size_t index = begin + 1; index < end; ++index)
+		{
+			value = reduce(value, transform(first[index]));
+		}
+		partials[blockIndex] = value;
+	});
+
+	for (const auto& partial : partials)
+	{
+		init = reduce(init, partial);
+	}
+	return init;
+}
+
+// out may be equal to first
+template<typename InputIt, typename OutputIt, typename BinaryOperation = std::plus<>>
+OutputIt parallelInclusiveScan(TaskFactory& factory, TaskExecuter& executor, InputIt first, InputIt last, OutputIt out, BinaryOperation operation = {})
+{
+	using ValueType = typename std::iterator_traits<InputIt>::value_type;
+
+	const size_t count = std::distance(first, last);
+	const size_t grainSize = Detail::getGrainSize<ValueType>(count, executor.getThreadCount());
+	const size_t blockCount = (count + grainSize - 1) / grainSize;
+	if (blockCount <= 1)
+	{
+		return std::inclusive_scan(first, last, out, operation);
+	}
+
+	// first pass: the sum of every block
+	std::vector<ValueType> carries(blockCount);
+	Detail::forEachBlock(factory, executor, count, grainSize, [&](size_t blockIndex, size_t begin, size_t end)
+	{
+		carries[blockIndex] = std::reduce(first + begin + 1, first + end, ValueType(first[begin]), operation);
+	});
+
+	// turn the sums into the carry coming from all previous blocks
+	for (size_t blockIndex = 2; blockIndex < blockCount; ++blockIndex)
+	{
+		carries[blockIndex - 1] = operation(carries[blockIndex - 2], carries[blockIndex - 1]);
+	}
+
+	// second pass: scan every block starting from its carry
+	Detail::forEachBlock(factory, executor, count, grainSize, [&](size_t blockIndex, size_t begin, size_t end)
+	{
+		if (blockIndex == 0)
+		{
+			std::inclusive_scan(first + begin, first + end, out + begin, operation);
+		}
+		else
+		{
+			std::inclusive_scan(first + begin, first + end, out + begin, operation, carries[blockIndex - 1]);
+		}
+	});
+
+	return out + count;
+}
+
+// out may be equal to first
+template<typename InputIt, typename OutputIt, typename ValueType, typename BinaryOperation = std::plus<>>
+OutputIt parallelExclusiveScan(TaskFactory& factory, TaskExecuter& executor, InputIt first, InputIt last, OutputIt out, ValueType init, BinaryOperation operation = {})
+{
+	const size_t count = std::distance(first, last);
+	const size_t grainSize = Detail::getGrainSize<ValueType>(count, executor.getThreadCount());
+	const size_t blockCount = (count + grainSize - 1) / grainSize;
+	if (blockCount <= 1)
+	{
+		return std::exclusive_scan(first, last, out, init, operation);
+	}
+
+	std::vector<ValueType> carries(blockCount);
+	Detail::forEachBlock(factory, executor, count, grainSize, [&](size_t blockIndex, size_t begin, size_t end)
+	{
+		carries[blockIndex] = std::reduce(first + begin + 1, first + end, ValueType(first[begin]), operation);
+	});
+
+	// exclusive prefix of the block sums
+	ValueType carry = init;
+	for (auto& value : carries)
+	{
+		auto sum = operation(carry, value);
+		value = carry;
+		carry = sum;
+	}
+
+	Detail::forEachBlock(factory, executor, count, grainSize, [&](size_t blockIndex, size_t begin, size_t end)
+	{
+		std::exclusive_scan(first + begin, first + end, out + begin, carries[blockIndex], operation);
+	});
+
+	return out + count;
+}
+
+// Sorts the blocks in parallel and merges neighbouring runs pass by pass. Every merge is split along
+// its merge path into blocks of grain size output, so the last passes, which merge few long runs,
+// still run on all workers. The values are moved to a scratch buffer for the whole range, which is
+// the only temporary allocation; the value type only has to be move constructible and assignable.
+template<typename RandomIt, typename Compare = std::less<>>
+void parallelSort(TaskFactory& factory, TaskExecuter& executor, RandomIt first, RandomIt last, Compare compare = {})
+{
+	using ValueType = typename std::iterator_traits<RandomIt>::value_type;
+
+	const size_t count = std::distance(first, last);
+	const size_t grainSize = Detail::getGrainSize<ValueType>(count, executor.getThreadCount());
+	if (count <= grainSize)
+	{
+		std::sort(first, last, compare);
+		return;
+	}
+
+	std::allocator<ValueType> allocator;
+	ValueType* buffer = allocator.allocate(count);
+
+	// the blocks are sorted in the buffer, so moving them there costs no extra pass over memory
+	Detail::forEachBlock(factory, executor, count, grainSize, [&](size_t, size_t begin, size_t end)
+	{
+		std::uninitialized_move(first + begin, first + end, buffer + begin);
+		std::sort(buffer + begin, buffer + end, compare);
+	});
+
+	bool isInBuffer = true;
+	for (size_t runSize = grainSize; runSize < count; runSize *= 2)
+	{
+		if (isInBuffer)
+		{
+			Detail::mergeRuns(factory, executor, buffer, first, count, runSize, grainSize, compare);
+		}
+		else
+		{
+			Detail::mergeRuns(factory, executor, first, buffer, count, runSize, grainSize, compare);
+		}
+		isInBuffer = !isInBuffer;
+	}
+
+	Detail::forEachBlock(factory, executor, count, grainSize, [&](size_t, size_t begin, size_t end)
+	{
+		if (isInBuffer)
+		{
+			std::move(buffer + begin, buffer + end, first + begin);
+		}
+		std::destroy(buffer + begin, buffer + end);
+	});
+
+	allocator.deallocate(buffer, count);
+}
@@ -1,7 +1,75 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
+#include <chrono>
+
+enum class SchedulingPolicy
+{
+	CriticalPath,	// ready tasks with the longest remaining path first
+	Fifo			// ready tasks in the order they were added
+};
 
 namespace Detail
 {
-	inline const std::uint32_t POOL_SIZE = 250;
-}
\ No newline at end of file
+	inline constexpr std::uint32_t POOL_SIZE = 250;
+
+	// number of retired task groups that triggers a batched reclamation on group creation
+	inline constexpr std::uint32_t RECLAIM_BATCH_SIZE = 32;
+
+	// cost (in nanoseconds) assumed for a task without a hint and without measured history
+	inline constexpr std::uint64_t DEFAULT_TASK_COST = 1000;
+
+	// the shared cost estimate of a job type is written only when a thread's own running average
+	// differs from it by more than 1 / 2^this
+	inline constexpr std::uint32_t COST_ESTIMATE_TOLERANCE_LOG2 = 4;
+	// job types whose running average a thread keeps at once
+	inline constexpr std::size_t COST_ESTIMATE_SLOT_COUNT = 64;
+
+	inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+	// bytes of the widest vector register a kernel is expected to use (AVX2)
+	inline constexpr std::size_t SIMD_REGISTER_SIZE = 32;
+	inline constexpr std::size_t L2_CACHE_SIZE = 256 * 1024;
+
+	// a worker idle for longer than this is retired when the executor runs above its minimum size
+	inline constexpr std::chrono::milliseconds WORKER_IDLE_TIMEOUT{ 500 };
+
+	// nodes of a streaming group are stored and released in sections of this many nodes
+	inline constexpr std::uint32_t STREAM_SECTION_SIZE_LOG2 = 8;
+	inline constexpr std::uint32_t STREAM_SECTION_SIZE = std::uint32_t(1) << STREAM_SECTION_SIZE_LOG2;
+
+	// the default arena included
+	inline constexpr std::uint16_t MAX_ARENA_COUNT = 8;
+
+	// threads blocked in TaskExecuter::push which run tasks meanwhile, each in a slot of its own
+	inline constexpr std::uint16_t MAX_HELPER_COUNT = 4;
+
+	// how many times other workers pass over a ready task with an affinity before one of them steals it
+	inline constexpr std::uint32_t AFFINITY_STEAL_THRESHOLD = 8;
+
+	// slab size classes are the powers of two from 16 bytes to SLAB_MAX_BLOCK_SIZE
+	inline constexpr std::uint32_t SLAB_MIN_BLOCK_SIZE_LOG2 = 4;
+	inline constexpr std::uint32_t SLAB_MAX_BLOCK_SIZE_LOG2 = 16;
+	inline constexpr std::size_t SLAB_MAX_BLOCK_SIZE = std::size_t(1) << SLAB_MAX_BLOCK_SIZE_LOG2;
+	inline constexpr std::uint32_t SLAB_CLASS_COUNT = SLAB_MAX_BLOCK_SIZE_LOG2 - SLAB_MIN_BLOCK_SIZE_LOG2 + 1;
+
+	// a thread cache moves up to SLAB_MAX_BATCH_SIZE blocks, but no more than SLAB_CACHE_SIZE bytes, at once
+	inline constexpr std::uint32_t SLAB_MAX_BATCH_SIZE = 32;
+	inline constexpr std::size_t SLAB_CACHE_SIZE = 64 * 1024;
+
+	inline constexpr std::size_t DEFAULT_SLAB_MEMORY_SIZE = 32 * 1024 * 1024;
+}
+
+// sizes the memory of the scheduler at startup, see TaskFactory
+struct SchedulerConfig
+{
+	// task groups alive at once in a TaskFactory, at most 65536
+	std::uint32_t maxTaskGroupCount = Detail::POOL_SIZE;
+
+	// region shared by the nodes, edges and job payloads of all factories; 0 keeps them on the heap
+	std::size_t slabMemorySize = Detail::DEFAULT_SLAB_MEMORY_SIZE;
+
+	// touch the whole region at startup instead of page faulting during the first seconds
+	bool prefaultMemory = false;
+	bool useHugePages = false;
+};
\ No newline at end of file
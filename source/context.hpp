@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <memory>
 #include <any>
+#include <atomic>
 
 #include "private/job_creator.hpp"
 #include "private/handle_array.hpp"
@@ -11,14 +12,10 @@ using ContextID = std::uint16_t;
 
 struct Context
 {
-	~Context()
-	{
-		std::cout << "~Context()" << std::endl;
-	}
-
 	void(*job)(std::shared_ptr<void>&, std::any&);
 	std::shared_ptr<void> data;
 	std::any returnedValue;
+	std::atomic<std::uint64_t>* costEstimate = nullptr;
 };
 
 /*template<std::uint32_t PoolSize>
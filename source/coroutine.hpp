@@ -0,0 +1,265 @@
+#pragma once
+
+#if !defined(__cpp_impl_coroutine) && !(defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#error "coroutine.hpp needs C++20, build the JOB_SYSTEM_COROUTINES target"
+#endif
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+
+#include "task.hpp"
+#include "task_executor.hpp"
+#include "private/slab_allocator.hpp"
+#include "utils/event.hpp"
+
+// Coroutine jobs on top of Task, available in C++20 builds only.
+//
+//     AsyncJob<int> load(TaskFactory& factory)
+//     {
+//         int size = co_await factory.createTask(readSize);
+//         co_return co_await factory.createTask(readData, size);
+//     }
+//
+//     auto job = load(factory);
+//     job.start(executor, arena);
+//
+// A job does nothing until start, which runs it on the calling thread up to the first co_await.
+// co_await on a Task submits the task's group to the executor and arena the job was started with
+// and suspends; a resume job, a group of its own from the task's pool, is queued there as well and
+// becomes ready once the task has finished, so everything after it runs on executor workers. A
+// suspended job holds only its frame, which comes from the slab allocator, and its resume job. A task can be awaited by one coroutine only. A started job may be destroyed
+// before it has finished, the frame then destroys itself at the end.
+
+namespace Detail
+{
+	template<typename ReturnedType>
+	class AsyncResult
+	{
+	public:
+		template<typename Value>
+		void return_value(Value&& value)
+		{
+			m_value.emplace(std::forward<Value>(value));
+		}
+
+		ReturnedType takeValue()
+		{
+			return std::move(*m_value);
+		}
+
+	private:
+		std::optional<ReturnedType> m_value;
+	};
+
+	template<>
+	class AsyncResult<void>
+	{
+	public:
+		void return_void() noexcept
+		{}
+
+		void takeValue() noexcept
+		{}
+	};
+}
+
+template<typename ReturnedType = void>
+class AsyncJob
+{
+public:
+	class promise_type;
+	using Handle = std::coroutine_handle<promise_type>;
+
+	class PromiseBase : public Detail::AsyncResult<ReturnedType>
+	{
+	public:
+		static void* operator new(std::size_t size)
+		{
+			return Detail::slabAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+		}
+
+		static void operator delete(void* pointer, std::size_t size) noexcept
+		{
+			Detail::slabDeallocate(pointer, size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+		}
+
+		// the job waits for start to learn its executor and arena
+		std::suspend_always initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		// the repo does not use exceptions
+		void unhandled_exception() noexcept
+		{
+			std::terminate();
+		}
+
+		template<typename TaskType>
+		auto await_transform(Task<TaskType> task)
+		{
+			assert(m_executor);
+			return TaskAwaiter<TaskType>(std::move(task), *m_executor, m_arena);
+		}
+
+	protected:
+		friend class AsyncJob;
+
+		TaskExecuter* m_executor = nullptr;
+		TaskExecuter::ArenaID m_arena = TaskExecuter::DEFAULT_ARENA;
+		Event m_finishedEvent;
+
+		// one reference of the frame and one of the AsyncJob, the last one destroys the frame
+		std::atomic<std::uint32_t> m_refCount = 2;
+	};
+
+	class promise_type : public PromiseBase
+	{
+	public:
+		using PromiseBase::PromiseBase;
+
+		AsyncJob get_return_object() noexcept
+		{
+			return AsyncJob(Handle::from_promise(*this));
+		}
+
+		auto final_suspend() noexcept
+		{
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept
+				{
+					return false;
+				}
+
+				void await_suspend(Handle handle) noexcept
+				{
+					auto& promise = handle.promise();
+					promise.m_finishedEvent.notify();
+					release(handle);
+				}
+
+				void await_resume() noexcept
+				{}
+			};
+
+			return FinalAwaiter{};
+		}
+	};
+
+	AsyncJob(AsyncJob&& other) noexcept :
+		m_handle(other.m_handle),
+		m_isStarted(other.m_isStarted)
+	{
+		other.m_handle = nullptr;
+	}
+
+	AsyncJob(const AsyncJob&) = delete;
+	AsyncJob& operator=(const AsyncJob&) = delete;
+	AsyncJob& operator=(AsyncJob&&) = delete;
+
+	~AsyncJob()
+	{
+		if (m_handle)
+		{
+			if (m_isStarted)
+			{
+				release(m_handle);
+			}
+			else
+			{
+				m_handle.destroy();
+			}
+		}
+	}
+
+	// runs the job on the calling thread up to its first co_await; the tasks it awaits are
+	// submitted to the arena of the executor
+	void start(TaskExecuter& executor, TaskExecuter::ArenaID arena = TaskExecuter::DEFAULT_ARENA)
+	{
+		assert(m_handle && !m_isStarted);
+		m_isStarted = true;
+
+		auto& promise = m_handle.promise();
+		promise.m_executor = &executor;
+		promise.m_arena = arena;
+		m_handle.resume();
+	}
+
+	// blocks until the coroutine has returned
+	void wait()
+	{
+		assert(m_handle && m_isStarted);
+		m_handle.promise().m_finishedEvent.wait();
+	}
+
+	// moves the result out, so it can be taken only once
+	ReturnedType get()
+	{
+		wait();
+		return m_handle.promise().takeValue();
+	}
+
+private:
+	template<typename TaskType>
+	class TaskAwaiter
+	{
+	public:
+		TaskAwaiter(Task<TaskType> task, TaskExecuter& executor, TaskExecuter::ArenaID arena) noexcept :
+			m_task(std::move(task)),
+			m_executor(executor),
+			m_arena(arena)
+		{}
+
+		bool await_ready() const
+		{
+			return m_task.isFinished();
+		}
+
+		// the coroutine is not resumed from the completion of the task, which would hold back the
+		// task's group and run the coroutine inside the task; its resume job goes through push and
+		// the admission control of the executor like any other group
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			auto& executor = m_executor;
+			const auto arena = m_arena;
+			m_task.submit(executor, arena);
+
+			// the group has been submitted, so then starts a group released by the task
+			auto resume = m_task.then([handle](Task<TaskType>&) { handle.resume(); });
+
+			// a worker may resume the coroutine and destroy this awaiter from here on
+			resume.submit(executor, arena);
+		}
+
+		TaskType await_resume()
+		{
+			return m_task.get();
+		}
+
+	private:
+		Task<TaskType> m_task;
+		TaskExecuter& m_executor;
+		const TaskExecuter::ArenaID m_arena;
+	};
+
+	explicit AsyncJob(Handle handle) noexcept :
+		m_handle(handle)
+	{}
+
+	static void release(Handle handle) noexcept
+	{
+		if (--handle.promise().m_refCount == 0)
+		{
+			handle.destroy();
+		}
+	}
+
+private:
+	Handle m_handle;
+	bool m_isStarted = false;
+};
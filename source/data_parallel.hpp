@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+#include "algorithms.hpp"
+#include "config.hpp"
+#include "task_factory.hpp"
+#include "task_executor.hpp"
+
+// Data-parallel loops over contiguous arrays for vectorisable kernels. Instead of one task per
+// element, the range is cut into a few dozen blocks (see Detail::getGrainSize) and the kernel is
+// called once per block with plain pointers, so its inner loop is an ordinary counted loop the
+// compiler can vectorise. The kernel is called as kernel(block, pointers...) where block is
+//   SimdBlock<Width> - length is a multiple of Width and the first pointer is aligned to
+//                      Width elements (the other arrays are only aligned if they share its alignment);
+//   SimdBlock<1>     - the unaligned head or the tail shorter than Width, run on the calling thread.
+// A generic lambda can tell the two apart with `if constexpr (decltype(block)::WIDTH > 1)`.
+// Like the other parallel algorithms it blocks the caller, so it must not be called from a job
+// running on the same executor.
+
+template<size_t Width>
+struct SimdBlock
+{
+	static constexpr size_t WIDTH = Width;
+
+	// index of the first element of the block within the whole range
+	size_t offset;
+	size_t length;
+};
+
+namespace Detail
+{
+	template<typename ValueType>
+	inline constexpr size_t SIMD_WIDTH = std::max<size_t>(SIMD_REGISTER_SIZE / sizeof(ValueType), 1);
+
+	template<typename Kernel, typename Block, typename ... Pointers>
+	void runSimdBlock(Kernel& kernel, Block block, const std::tuple<Pointers...>& pointers)
+	{
+		std::apply([&](auto* ... pointer) { kernel(block, (pointer + block.offset)...); }, pointers);
+	}
+}
+
+// runs kernel over [0, count) of the arrays data... (structure of arrays, all of at least count elements);
+// Width is the number of elements processed by one vector instruction, by default that of the first array
+template<size_t Width = 0, typename Kernel, typename First, typename ... Rest>
+void parallelForSimd(TaskFactory& factory, TaskExecuter& executor, size_t count, Kernel kernel, First* first, Rest*... rest)
+{
+	constexpr size_t width = Width != 0 ? Width : Detail::SIMD_WIDTH<First>;
+	static_assert((width & (width - 1)) == 0, "the SIMD width has to be a power of two");
+
+	const std::tuple<First*, Rest*...> pointers(first, rest...);
+
+	// scalar head up to the first element aligned to a whole vector
+	constexpr size_t vectorBytes = width * sizeof(First);
+	const auto address = reinterpret_cast<std::uintptr_t>(first);
+	size_t head = 0;
+	if (address % alignof(First) == 0 && (vectorBytes & (vectorBytes - 1)) == 0)
+	{
+		head = std::min(((vectorBytes - address % vectorBytes) % vectorBytes) / sizeof(First), count);
+	}
+
+	if (head != 0)
+	{
+		Detail::runSimdBlock(kernel, SimdBlock<1>{ 0, head }, pointers);
+	}
+
+	const size_t vectorCount = (count - head) / width * width;
+	if (vectorCount != 0)
+	{
+		// every block but the last is a whole number of vectors, so only the end of the range needs the tail
+		size_t grainSize = Detail::getGrainSize<First>(vectorCount, executor.getThreadCount());
+		grainSize = (grainSize + width - 1) / width * width;
+
+		Detail::forEachBlock(factory, executor, vectorCount, grainSize, [&kernel, &pointers, head](size_t, size_t begin, size_t end)
+		{
+			Detail::runSimdBlock(kernel, SimdBlock<width>{ head + begin, end - begin }, pointers);
+		});
+	}
+
+	const size_t tail = count - head - vectorCount;
+	if (tail != 0)
+	{
+		Detail::runSimdBlock(kernel, SimdBlock<1>{ head + vectorCount, tail }, pointers);
+	}
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../algorithms.hpp"
+#include "../data_parallel.hpp"
+#include "../task_factory.hpp"
+#include "../task_executor.hpp"
+
+#include "../utils/time_utils.hpp"
+
+// Compares the parallel algorithms with their sequential std:: counterparts:
+//   benchmark [element count] [worker count]
+
+namespace
+{
+	template<typename Callable>
+	std::uint64_t measure(Callable&& callable)
+	{
+		ManualTimer timer;
+		timer.start();
+		callable();
+		return timer.end();
+	}
+
+	void report(const char* name, std::uint64_t sequential, std::uint64_t parallel, bool isEqual)
+	{
+		std::cout << name << ": std " << sequential / 1000 << " us, parallel " << parallel / 1000 << " us, speedup "
+			<< double(sequential) / double(parallel) << (isEqual ? "" : "  RESULT MISMATCH") << std::endl;
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 24;
+	const auto workerCount = static_cast<std::uint16_t>(argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency()));
+
+	TaskFactory factory;
+	TaskExecuter executor(workerCount);
+
+	std::mt19937_64 random(42);
+	std::vector<std::uint64_t> input(count);
+	std::generate(input.begin(), input.end(), [&random]() { return random() % 1000000; });
+
+	std::cout << count << " elements, " << workerCount << " workers" << std::endl;
+
+	{
+		auto expected = input;
+		auto result = input;
+		auto sequential = measure([&]() { std::sort(expected.begin(), expected.end()); });
+		auto parallel = measure([&]() { parallelSort(factory, executor, result.begin(), result.end()); });
+		report("sort", sequential, parallel, expected == result);
+	}
+
+	{
+		std::vector<std::uint64_t> expected(count);
+		std::vector<std::uint64_t> result(count);
+		auto sequential = measure([&]() { std::inclusive_scan(input.begin(), input.end(), expected.begin()); });
+		auto parallel = measure([&]() { parallelInclusiveScan(factory, executor, input.begin(), input.end(), result.begin()); });
+		report("inclusive_scan", sequential, parallel, expected == result);
+	}
+
+	{
+		std::vector<std::uint64_t> expected(count);
+		std::vector<std::uint64_t> result(count);
+		auto sequential = measure([&]() { std::exclusive_scan(input.begin(), input.end(), expected.begin(), std::uint64_t(0)); });
+		auto parallel = measure([&]() { parallelExclusiveScan(factory, executor, input.begin(), input.end(), result.begin(), std::uint64_t(0)); });
+		report("exclusive_scan", sequential, parallel, expected == result);
+	}
+
+	{
+		auto square = [](std::uint64_t value) { return value * value; };
+		std::uint64_t expected = 0;
+		std::uint64_t result = 0;
+		auto sequential = measure([&]() { expected = std::transform_reduce(input.begin(), input.end(), std::uint64_t(0), std::plus<>(), square); });
+		auto parallel = measure([&]() { result = parallelTransformReduce(factory, executor, input.begin(), input.end(), std::uint64_t(0), std::plus<>(), square); });
+		report("transform_reduce", sequential, parallel, expected == result);
+	}
+
+	{
+		// y = a * x + y over float arrays
+		std::vector<float> x(count);
+		std::transform(input.begin(), input.end(), x.begin(), [](std::uint64_t value) { return float(value % 1000); });
+		std::vector<float> expected(count, 1.0f);
+		std::vector<float> result(count, 1.0f);
+		const float a = 2.0f;
+
+		auto sequential = measure([&]() { std::transform(x.begin(), x.end(), expected.begin(), expected.begin(), [a](float xi, float yi) { return a * xi + yi; }); });
+		auto parallel = measure([&]()
+		{
+			parallelForSimd(factory, executor, count, [a](auto block, const float* xs, float* ys)
+			{
+				for (size_t index = 0; index < block.length; ++index)
+				{
+					ys[index] = a * xs[index] + ys[index];
+				}
+			}, x.data(), result.data());
+		});
+		report("saxpy", sequential, parallel, expected == result);
+	}
+
+	return 0;
+}
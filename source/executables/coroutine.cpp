@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../coroutine.hpp"
+#include "../task_factory.hpp"
+#include "../task_executor.hpp"
+
+// Example of coroutine jobs, built only with the JOB_SYSTEM_COROUTINES option:
+//   coroutine_example [job count]
+
+namespace
+{
+	AsyncJob<std::uint64_t> sumSquares(TaskFactory& factory, std::uint64_t count)
+	{
+		std::uint64_t sum = 0;
+		for (std::uint64_t value = 1; value <= count; ++value)
+		{
+			// every step suspends the job instead of blocking a thread
+			sum += co_await factory.createTask([](std::uint64_t x) { return x * x; }, std::uint64_t{ value });
+		}
+
+		co_return sum;
+	}
+
+	AsyncJob<> report(TaskFactory& factory, std::uint32_t index)
+	{
+		auto threadId = co_await factory.createTask([]() { return std::this_thread::get_id(); });
+		std::cout << "job " << index << " resumed after a task run on thread " << threadId << std::endl;
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	const std::uint32_t jobCount = argc > 1 ? std::atoi(argv[1]) : 8;
+
+	TaskFactory factory;
+	TaskExecuter executor(4);
+
+	std::vector<AsyncJob<std::uint64_t>> jobs;
+	for (std::uint32_t index = 0; index < jobCount; ++index)
+	{
+		jobs.push_back(sumSquares(factory, 100 + index));
+		jobs.back().start(executor);
+	}
+
+	for (std::uint32_t index = 0; index < jobCount; ++index)
+	{
+		const std::uint64_t count = 100 + index;
+		const auto expected = count * (count + 1) * (2 * count + 1) / 6;
+		const auto sum = jobs[index].get();
+		std::cout << "sum of squares up to " << count << ": " << sum << (sum == expected ? "" : "  WRONG") << std::endl;
+	}
+
+	// the arena of the job is where the tasks it awaits run
+	const auto ioArena = executor.createArena("io", 1);
+	auto job = report(factory, 0);
+	job.start(executor, ioArena);
+	job.wait();
+	return 0;
+}
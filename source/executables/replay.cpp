@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../graph_capture.hpp"
+#include "../task_factory.hpp"
+#include "../task_executor.hpp"
+
+#include "../utils/time_utils.hpp"
+
+// Replays a graph capture (see GraphRecorder) with busy-work jobs of the recorded durations:
+//   graph_replay <capture file> [worker count] [critical-path|fifo]
+
+namespace
+{
+	void busyWork(std::uint64_t duration)
+	{
+		const auto start = getTimestamp();
+		while (getTimestamp() - start < duration)
+		{}
+	}
+
+	// false if the graph has a cycle and can not be replayed
+	bool getCriticalPath(const CapturedGraph& graph, std::uint64_t& result)
+	{
+		const auto nodeCount = graph.executionTimes.size();
+
+		std::vector<std::vector<std::uint32_t>> children(nodeCount);
+		std::vector<std::uint32_t> parentCounts(nodeCount, 0);
+		for (const auto& [from, to] : graph.edges)
+		{
+			children[from].push_back(to);
+			++parentCounts[to];
+		}
+
+		// longest path ending in every node, in Kahn order
+		std::vector<std::uint64_t> finish(nodeCount, 0);
+		std::vector<std::uint32_t> ready;
+		for (std::uint32_t index = 0; index < nodeCount; ++index)
+		{
+			if (parentCounts[index] == 0)
+			{
+				ready.push_back(index);
+			}
+		}
+
+		result = 0;
+		std::uint32_t visitedCount = 0;
+		while (!ready.empty())
+		{
+			auto index = ready.back();
+			ready.pop_back();
+			++visitedCount;
+
+			finish[index] += graph.executionTimes[index];
+			result = std::max(result, finish[index]);
+
+			for (auto child : children[index])
+			{
+				finish[child] = std::max(finish[child], finish[index]);
+				if (--parentCounts[child] == 0)
+				{
+					ready.push_back(child);
+				}
+			}
+		}
+
+		return visitedCount == nodeCount;
+	}
+
+	std::uint64_t replay(const CapturedGraph& graph, TaskFactory& factory, TaskExecuter& executor)
+	{
+		auto& group = factory.createTaskGroup();
+		for (auto duration : graph.executionTimes)
+		{
+			// the recorded time is the exact cost, so the priorities match the captured run
+			auto nodeID = group.addNode(&busyWork, std::uint64_t{ duration });
+			group.getTaskNode(nodeID)->setCost(duration);
+		}
+
+		std::vector<bool> isSink(graph.executionTimes.size(), true);
+		for (const auto& [from, to] : graph.edges)
+		{
+			group.link(from, to);
+			isSink[from] = false;
+		}
+
+		std::vector<Task<void>> sinks;
+		for (size_t index = 0; index < isSink.size(); ++index)
+		{
+			if (isSink[index])
+			{
+				sinks.emplace_back(group.getTaskNode(index));
+			}
+		}
+
+		ManualTimer timer;
+		timer.start();
+		for (auto& sink : sinks)
+		{
+			sink.wait(executor);
+		}
+		return timer.end();
+	}
+
+	// false unless text is a whole number in 1 .. 65535
+	bool parseWorkerCount(const char* text, std::uint16_t& result)
+	{
+		char* end = nullptr;
+		errno = 0;
+		const auto value = std::strtol(text, &end, 10);
+		if (end == text || *end != '\0' || errno == ERANGE || value < 1 || value > std::numeric_limits<std::uint16_t>::max())
+		{
+			return false;
+		}
+
+		result = static_cast<std::uint16_t>(value);
+		return true;
+	}
+
+	void printUsage()
+	{
+		std::cout << "usage: graph_replay <capture file> [worker count] [critical-path|fifo]" << std::endl;
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	auto workerCount = static_cast<std::uint16_t>(std::max(1u, std::thread::hardware_concurrency()));
+	if (argc < 2 || (argc > 2 && !parseWorkerCount(argv[2], workerCount)))
+	{
+		printUsage();
+		return 1;
+	}
+
+	std::vector<CapturedGraph> graphs;
+	if (!readGraphCapture(argv[1], graphs))
+	{
+		std::cout << "can not read capture file " << argv[1] << std::endl;
+		return 1;
+	}
+
+	const std::string policyName = argc > 3 ? argv[3] : "critical-path";
+	const auto policy = policyName == "fifo" ? SchedulingPolicy::Fifo : SchedulingPolicy::CriticalPath;
+
+	TaskFactory factory;
+	TaskExecuter executor(workerCount);
+	executor.setSchedulingPolicy(policy);
+
+	std::uint64_t totalMakespan = 0;
+	std::uint64_t totalWork = 0;
+	std::uint64_t totalCriticalPath = 0;
+	for (size_t index = 0; index < graphs.size(); ++index)
+	{
+		const auto& graph = graphs[index];
+		if (graph.executionTimes.empty())
+		{
+			continue;
+		}
+
+		std::uint64_t work = 0;
+		for (auto duration : graph.executionTimes)
+		{
+			work += duration;
+		}
+
+		std::uint64_t criticalPath = 0;
+		if (!getCriticalPath(graph, criticalPath))
+		{
+			std::cout << "graph " << index << ": skipped, it has a cycle" << std::endl;
+			continue;
+		}
+
+		const auto makespan = replay(graph, factory, executor);
+
+		totalMakespan += makespan;
+		totalWork += work;
+		totalCriticalPath += criticalPath;
+
+		std::cout << "graph " << index << ": nodes " << graph.executionTimes.size()
+			<< ", makespan " << makespan << " ns"
+			<< ", utilisation " << 100.0 * work / (double(makespan) * workerCount) << " %"
+			<< ", critical path efficiency " << 100.0 * criticalPath / makespan << " %" << std::endl;
+	}
+
+	if (totalMakespan != 0)
+	{
+		std::cout << "total (" << workerCount << " workers, " << policyName << "): makespan " << totalMakespan << " ns"
+			<< ", utilisation " << 100.0 * totalWork / (double(totalMakespan) * workerCount) << " %"
+			<< ", critical path efficiency " << 100.0 * totalCriticalPath / totalMakespan << " %" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+#include "graph_capture.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "task_group.hpp"
+
+namespace
+{
+	const char CAPTURE_MAGIC[4] = { 'J', 'S', 'G', 'C' };
+
+	template<typename ValueType>
+	void writeValue(std::ostream& stream, const ValueType& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(ValueType));
+	}
+
+	template<typename ValueType>
+	void appendValue(std::vector<char>& buffer, const ValueType& value)
+	{
+		const auto* bytes = reinterpret_cast<const char*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(ValueType));
+	}
+
+	template<typename ValueType>
+	bool readValue(std::istream& stream, ValueType& value)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(ValueType)));
+	}
+}
+
+GraphRecorder::GraphRecorder(const std::string& path) :
+	m_file(path, std::ios::binary | std::ios::trunc)
+{
+	if (m_file)
+	{
+		m_file.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+		writeValue(m_file, VERSION);
+		m_writer = std::thread([this]() { write(); });
+	}
+}
+
+GraphRecorder::~GraphRecorder()
+{
+	if (m_writer.joinable())
+	{
+		{
+			std::lock_guard guard(m_pendingMutex);
+			m_isStopped = true;
+		}
+		m_pendingCondition.notify_one();
+		m_writer.join();
+	}
+}
+
+bool GraphRecorder::isOpen() const
+{
+	return m_file.is_open();
+}
+
+void GraphRecorder::record(TaskGroup& group)
+{
+	const auto nodeCount = static_cast<std::uint32_t>(group.getNodeCount());
+	if (!m_writer.joinable() || nodeCount > MAX_NODE_COUNT)
+	{
+		return;
+	}
+
+	// the group is recycled once its last task has finished, so it is serialized right here
+	std::vector<char> graph;
+	std::vector<std::uint32_t> edges;
+	appendValue(graph, nodeCount);
+	appendValue(graph, std::uint32_t{ 0 });
+	for (std::uint32_t index = 0; index < nodeCount; ++index)
+	{
+		auto* node = group.getTaskNode(index);
+		appendValue(graph, node->getExecutionTime());
+		node->forEachAdjancedNode([&edges, index](size_t child)
+		{
+			edges.push_back(index);
+			edges.push_back(static_cast<std::uint32_t>(child));
+		});
+	}
+
+	const auto edgeCount = static_cast<std::uint32_t>(edges.size() / 2);
+	std::memcpy(graph.data() + sizeof(nodeCount), &edgeCount, sizeof(edgeCount));
+	const auto* edgeBytes = reinterpret_cast<const char*>(edges.data());
+	graph.insert(graph.end(), edgeBytes, edgeBytes + edges.size() * sizeof(std::uint32_t));
+
+	{
+		std::lock_guard guard(m_pendingMutex);
+		m_pending.push_back(std::move(graph));
+	}
+	m_pendingCondition.notify_one();
+}
+
+void GraphRecorder::flush()
+{
+	std::unique_lock lock(m_pendingMutex);
+	m_writtenCondition.wait(lock, [this]() { return m_pending.empty() && !m_isWriting; });
+}
+
+void GraphRecorder::write()
+{
+	std::unique_lock lock(m_pendingMutex);
+	while (true)
+	{
+		m_pendingCondition.wait(lock, [this]() { return !m_pending.empty() || m_isStopped; });
+		if (m_pending.empty())
+		{
+			return;
+		}
+
+		// everything pending is written in one go and flushed once
+		std::vector<std::vector<char>> graphs;
+		graphs.swap(m_pending);
+		m_isWriting = true;
+		lock.unlock();
+
+		for (const auto& graph : graphs)
+		{
+			m_file.write(graph.data(), graph.size());
+		}
+		m_file.flush();
+
+		lock.lock();
+		m_isWriting = false;
+		m_writtenCondition.notify_all();
+	}
+}
+
+bool readGraphCapture(const std::string& path, std::vector<CapturedGraph>& graphs)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	const auto fileSize = static_cast<std::uint64_t>(std::max<std::streamoff>(file.tellg(), 0));
+	file.seekg(0);
+
+	char magic[sizeof(CAPTURE_MAGIC)] = {};
+	std::uint32_t version = 0;
+	if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0
+		|| !readValue(file, version) || version != GraphRecorder::VERSION)
+	{
+		return false;
+	}
+
+	std::uint32_t nodeCount = 0;
+	std::uint32_t edgeCount = 0;
+	while (readValue(file, nodeCount) && readValue(file, edgeCount))
+	{
+		// counts are checked against the rest of the file before anything is allocated for them
+		const auto remainingSize = fileSize - static_cast<std::uint64_t>(file.tellg());
+		const auto graphSize = std::uint64_t(nodeCount) * sizeof(std::uint64_t) + std::uint64_t(edgeCount) * 2 * sizeof(std::uint32_t);
+		if (nodeCount > GraphRecorder::MAX_NODE_COUNT || graphSize > remainingSize)
+		{
+			return false;
+		}
+
+		CapturedGraph graph;
+		graph.executionTimes.resize(nodeCount);
+		graph.edges.resize(edgeCount);
+
+		file.read(reinterpret_cast<char*>(graph.executionTimes.data()), nodeCount * sizeof(std::uint64_t));
+		for (auto& edge : graph.edges)
+		{
+			if (!readValue(file, edge.first) || !readValue(file, edge.second)
+				|| edge.first >= nodeCount || edge.second >= nodeCount || edge.first == edge.second)
+			{
+				return false;
+			}
+		}
+
+		if (!file)
+		{
+			return false;
+		}
+
+		graphs.push_back(std::move(graph));
+	}
+
+	return true;
+}
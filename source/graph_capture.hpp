@@ -0,0 +1,67 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class TaskGroup;
+
+// Binary layout (native byte order):
+//   header: "JSGC", uint32 version
+//   graph:  uint32 nodeCount, uint32 edgeCount,
+//           nodeCount x uint64 execution time in nanoseconds,
+//           edgeCount x (uint32 from, uint32 to)
+// A file holds any number of graphs, one per finished task group.
+struct CapturedGraph
+{
+	std::vector<std::uint64_t> executionTimes;
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+};
+
+// Appends every finished task group of a TaskFactory to a capture file,
+// see TaskFactory::setGraphRecorder. record() may be called from any worker; it only
+// serializes the graph, the file is written and flushed by a thread of the recorder.
+class GraphRecorder
+{
+public:
+	static constexpr std::uint32_t VERSION = 1;
+	// larger graphs are neither recorded nor read
+	static constexpr std::uint32_t MAX_NODE_COUNT = std::uint32_t(1) << 24;
+
+	explicit GraphRecorder(const std::string& path);
+	// writes the graphs which are still pending
+	~GraphRecorder();
+
+	GraphRecorder(const GraphRecorder&) = delete;
+	GraphRecorder& operator=(const GraphRecorder&) = delete;
+
+	bool isOpen() const;
+	void record(TaskGroup& group);
+
+	// blocks until every graph recorded so far is written to the file
+	void flush();
+
+private:
+	void write();
+
+private:
+	std::ofstream m_file;
+
+	std::mutex m_pendingMutex;
+	std::condition_variable m_pendingCondition;
+	std::condition_variable m_writtenCondition;
+	std::vector<std::vector<char>> m_pending;
+	bool m_isWriting = false;
+	bool m_isStopped = false;
+
+	std::thread m_writer;
+};
+
+// returns false if the file can not be opened, is not a capture file or holds a malformed graph:
+// more than GraphRecorder::MAX_NODE_COUNT nodes, more data than the file has or an edge which does
+// not connect two different nodes of the graph
+bool readGraphCapture(const std::string& path, std::vector<CapturedGraph>& graphs);
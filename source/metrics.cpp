@@ -0,0 +1,184 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+
+#include "utils/bit_utils.hpp"
+
+std::uint64_t HistogramSnapshot::getPercentile(double fraction) const noexcept
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	const auto target = static_cast<std::uint64_t>(fraction * static_cast<double>(count));
+	std::uint64_t accumulated = 0;
+	for (std::uint32_t index = 0; index < counts.size(); ++index)
+	{
+		accumulated += counts[index];
+		if (accumulated > target)
+		{
+			return LatencyHistogram::getBucketLowerBound(index);
+		}
+	}
+
+	return max;
+}
+
+std::uint64_t HistogramSnapshot::getMean() const noexcept
+{
+	return count ? sum / count : 0;
+}
+
+LatencyHistogram::LatencyHistogram() noexcept
+{
+	for (auto& bucket : m_buckets)
+	{
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+void LatencyHistogram::record(std::uint64_t value) noexcept
+{
+	m_buckets[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_sum.fetch_add(value, std::memory_order_relaxed);
+
+	auto max = m_max.load(std::memory_order_relaxed);
+	while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+	{}
+}
+
+HistogramSnapshot LatencyHistogram::getSnapshot() const
+{
+	HistogramSnapshot result;
+	addTo(result);
+	return result;
+}
+
+void LatencyHistogram::addTo(HistogramSnapshot& snapshot) const
+{
+	snapshot.counts.resize(BUCKET_COUNT);
+	for (std::uint32_t index = 0; index < BUCKET_COUNT; ++index)
+	{
+		const auto count = m_buckets[index].load(std::memory_order_relaxed);
+		snapshot.counts[index] += count;
+		snapshot.count += count;
+	}
+
+	snapshot.sum += m_sum.load(std::memory_order_relaxed);
+	snapshot.max = std::max(snapshot.max, m_max.load(std::memory_order_relaxed));
+}
+
+std::uint32_t LatencyHistogram::getBucketIndex(std::uint64_t value) noexcept
+{
+	if (value < SUB_BUCKET_COUNT)
+	{
+		return static_cast<std::uint32_t>(value);
+	}
+
+	const auto shift = Detail::highestBit(value) - SUB_BUCKET_BITS;
+	const auto subBucket = static_cast<std::uint32_t>(value >> shift) & (SUB_BUCKET_COUNT - 1);
+	return (shift + 1) * SUB_BUCKET_COUNT + subBucket;
+}
+
+std::uint64_t LatencyHistogram::getBucketLowerBound(std::uint32_t bucketIndex) noexcept
+{
+	const auto major = bucketIndex / SUB_BUCKET_COUNT;
+	const auto subBucket = bucketIndex % SUB_BUCKET_COUNT;
+	if (major == 0)
+	{
+		return subBucket;
+	}
+
+	return std::uint64_t(SUB_BUCKET_COUNT + subBucket) << (major - 1);
+}
+
+SchedulerMetrics::SchedulerMetrics(std::uint16_t workerCount) :
+	m_workerCount(workerCount),
+	m_workers(std::make_unique<WorkerMetrics[]>(workerCount + 1))
+{
+}
+
+WorkerMetrics& SchedulerMetrics::getWorker(std::uint16_t workerIndex) noexcept
+{
+	return m_workers[std::min(workerIndex, m_workerCount)];
+}
+
+void SchedulerMetrics::recordTask(std::uint16_t workerIndex, std::uint64_t queueWait, std::uint64_t executionTime) noexcept
+{
+	auto& worker = getWorker(workerIndex);
+	worker.tasksExecuted.fetch_add(1, std::memory_order_relaxed);
+	worker.runningTime.fetch_add(executionTime, std::memory_order_relaxed);
+	worker.queueWait.record(queueWait);
+	worker.execution.record(executionTime);
+}
+
+void SchedulerMetrics::recordParked(std::uint16_t workerIndex, std::uint64_t parkedTime) noexcept
+{
+	getWorker(workerIndex).parkedTime.fetch_add(parkedTime, std::memory_order_relaxed);
+}
+
+MetricsSnapshot SchedulerMetrics::getSnapshot() const
+{
+	MetricsSnapshot result;
+	result.workers.reserve(m_workerCount + 1);
+	for (std::uint32_t index = 0; index <= m_workerCount; ++index)
+	{
+		const auto& worker = m_workers[index];
+
+		WorkerMetricsSnapshot snapshot;
+		snapshot.tasksExecuted = worker.tasksExecuted.load(std::memory_order_relaxed);
+		snapshot.stealsAttempted = worker.stealsAttempted.load(std::memory_order_relaxed);
+		snapshot.stealsSucceeded = worker.stealsSucceeded.load(std::memory_order_relaxed);
+		snapshot.parkedTime = worker.parkedTime.load(std::memory_order_relaxed);
+		snapshot.runningTime = worker.runningTime.load(std::memory_order_relaxed);
+		result.workers.push_back(snapshot);
+
+		worker.queueWait.addTo(result.queueWait);
+		worker.execution.addTo(result.execution);
+	}
+
+	return result;
+}
+
+std::uint64_t TaskProfile::getQueueLatency() const noexcept
+{
+	return readyTime && readyTime < startTime ? startTime - readyTime : 0;
+}
+
+std::uint64_t TaskProfile::getExecutionTime() const noexcept
+{
+	return finishTime - startTime;
+}
+
+void GroupProfile::add(const TaskProfile& profile) noexcept
+{
+	const auto queueLatency = profile.getQueueLatency();
+	const auto executionTime = profile.getExecutionTime();
+
+	totalQueueLatency += queueLatency;
+	maxQueueLatency = std::max(maxQueueLatency, queueLatency);
+	totalExecutionTime += executionTime;
+	maxExecutionTime = std::max(maxExecutionTime, executionTime);
+
+	const auto readyTime = profile.readyTime ? profile.readyTime : profile.startTime;
+	firstReadyTime = taskCount == 0 ? readyTime : std::min(firstReadyTime, readyTime);
+	lastFinishTime = std::max(lastFinishTime, profile.finishTime);
+	++taskCount;
+}
+
+std::uint64_t GroupProfile::getMeanQueueLatency() const noexcept
+{
+	return taskCount ? totalQueueLatency / taskCount : 0;
+}
+
+std::uint64_t GroupProfile::getMeanExecutionTime() const noexcept
+{
+	return taskCount ? totalExecutionTime / taskCount : 0;
+}
+
+std::uint64_t GroupProfile::getMakespan() const noexcept
+{
+	return taskCount ? lastFinishTime - firstReadyTime : 0;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "config.hpp"
+
+struct HistogramSnapshot
+{
+	std::vector<std::uint64_t> counts;
+	std::uint64_t count = 0;
+	std::uint64_t sum = 0;
+	std::uint64_t max = 0;
+
+	// lower bound of the bucket holding the given fraction (0..1) of the samples
+	std::uint64_t getPercentile(double fraction) const noexcept;
+	std::uint64_t getMean() const noexcept;
+};
+
+// Histogram of nanosecond values with power-of-two major buckets, each split into
+// SUB_BUCKET_COUNT linear sub-buckets, so the relative error stays below 1 / SUB_BUCKET_COUNT.
+// record() is a few relaxed atomic increments and can be called from any thread.
+class LatencyHistogram
+{
+public:
+	static constexpr std::uint32_t SUB_BUCKET_BITS = 3;
+	static constexpr std::uint32_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+	static constexpr std::uint32_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+	LatencyHistogram() noexcept;
+
+	void record(std::uint64_t value) noexcept;
+	HistogramSnapshot getSnapshot() const;
+	// adds the samples to the snapshot, e.g. to merge the histograms of several workers
+	void addTo(HistogramSnapshot& snapshot) const;
+
+	static std::uint32_t getBucketIndex(std::uint64_t value) noexcept;
+	static std::uint64_t getBucketLowerBound(std::uint32_t bucketIndex) noexcept;
+
+private:
+	std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> m_buckets;
+	std::atomic<std::uint64_t> m_count = 0;
+	std::atomic<std::uint64_t> m_sum = 0;
+	std::atomic<std::uint64_t> m_max = 0;
+};
+
+// timestamps (see getTimestamp) of one task, set by the scheduler; ready is the moment
+// the last parent finished or the group was submitted
+struct TaskProfile
+{
+	std::uint64_t readyTime = 0;
+	std::uint64_t startTime = 0;
+	std::uint64_t finishTime = 0;
+
+	std::uint64_t getQueueLatency() const noexcept;
+	std::uint64_t getExecutionTime() const noexcept;
+};
+
+// summary over the finished tasks of a group
+struct GroupProfile
+{
+	std::uint32_t taskCount = 0;
+	std::uint64_t totalQueueLatency = 0;
+	std::uint64_t maxQueueLatency = 0;
+	std::uint64_t totalExecutionTime = 0;
+	std::uint64_t maxExecutionTime = 0;
+	std::uint64_t firstReadyTime = 0;
+	std::uint64_t lastFinishTime = 0;
+
+	void add(const TaskProfile& profile) noexcept;
+
+	std::uint64_t getMeanQueueLatency() const noexcept;
+	std::uint64_t getMeanExecutionTime() const noexcept;
+	// from the first task becoming ready to the last one finishing
+	std::uint64_t getMakespan() const noexcept;
+};
+
+struct WorkerMetricsSnapshot
+{
+	std::uint64_t tasksExecuted = 0;
+	std::uint64_t stealsAttempted = 0;
+	std::uint64_t stealsSucceeded = 0;
+	std::uint64_t parkedTime = 0;
+	std::uint64_t runningTime = 0;
+};
+
+struct MetricsSnapshot
+{
+	// one entry per worker and helper slot (see TaskExecuter::getSlotCount),
+	// the last one accumulates threads outside the executor
+	std::vector<WorkerMetricsSnapshot> workers;
+	HistogramSnapshot queueWait;
+	HistogramSnapshot execution;
+};
+
+struct alignas(Detail::CACHE_LINE_SIZE) WorkerMetrics
+{
+	std::atomic<std::uint64_t> tasksExecuted = 0;
+	std::atomic<std::uint64_t> stealsAttempted = 0;
+	std::atomic<std::uint64_t> stealsSucceeded = 0;
+	std::atomic<std::uint64_t> parkedTime = 0;
+	std::atomic<std::uint64_t> runningTime = 0;
+
+	// every worker records into its own histograms, so workers do not contend on the buckets
+	LatencyHistogram queueWait;
+	LatencyHistogram execution;
+};
+
+// Always-on counters of an executor. Times are in nanoseconds.
+// The histograms of the snapshot are merged from the histograms of all worker slots.
+class SchedulerMetrics
+{
+public:
+	explicit SchedulerMetrics(std::uint16_t workerCount);
+
+	// INVALID_WORKER_INDEX selects the slot of threads outside the executor
+	WorkerMetrics& getWorker(std::uint16_t workerIndex) noexcept;
+
+	void recordTask(std::uint16_t workerIndex, std::uint64_t queueWait, std::uint64_t executionTime) noexcept;
+	void recordParked(std::uint16_t workerIndex, std::uint64_t parkedTime) noexcept;
+
+	MetricsSnapshot getSnapshot() const;
+
+private:
+	const std::uint16_t m_workerCount;
+	std::unique_ptr<WorkerMetrics[]> m_workers;
+};
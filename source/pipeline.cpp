@@ -0,0 +1,171 @@
+#include "pipeline.hpp"
+
+#include <cassert>
+
+#include "task_factory.hpp"
+
+Pipeline::Pipeline(std::uint32_t maxTokens) :
+	m_maxTokens(maxTokens)
+{
+	assert(m_maxTokens > 0);
+}
+
+void Pipeline::setInput(InputFunction input)
+{
+	m_input = std::move(input);
+}
+
+void Pipeline::addStage(StageMode mode, StageFunction function)
+{
+	m_stages.emplace_back(mode, std::move(function));
+}
+
+void Pipeline::run(TaskFactory& factory, TaskExecuter& executor)
+{
+	assert(m_input);
+
+	m_nextTicket = 0;
+	m_isInputFinished = false;
+	m_inFlight = 0;
+	for (auto& stage : m_stages)
+	{
+		stage.nextTicket = 0;
+	}
+
+	// tokens are started from here only, so groups are created on the caller's side; submit may
+	// block under an in-flight limit while the tokens need the lock to finish, so the tokens are
+	// counted under the lock and submitted without it
+	std::unique_lock lock(m_tokenMutex);
+	while (true)
+	{
+		const std::uint32_t startCount = canStartToken() ? m_maxTokens - m_activeTokens : 0;
+		if (startCount > 0)
+		{
+			m_activeTokens += startCount;
+			lock.unlock();
+			for (std::uint32_t index = 0; index < startCount; ++index)
+			{
+				factory.createTask([this]() { runToken(); }).submit(executor);
+			}
+			lock.lock();
+			continue;
+		}
+
+		if (m_activeTokens == 0 && m_isInputFinished && m_inFlight == 0)
+		{
+			break;
+		}
+
+		m_tokenCondition.wait(lock);
+	}
+
+	assert(m_inFlight == 0 && m_resumable.empty());
+}
+
+void Pipeline::runToken()
+{
+	Item item;
+	while (popResumable(item) || fetchInput(item))
+	{
+		process(item);
+	}
+
+	// the limit is reached or the input is exhausted; an item which is unparked later is picked up
+	// by the token which unparks it, and run() starts a new token when an item leaves
+	// notified under the lock, run() may return and destroy the pipeline as soon as it is released
+	std::lock_guard guard(m_tokenMutex);
+	--m_activeTokens;
+	m_tokenCondition.notify_one();
+}
+
+bool Pipeline::canStartToken()
+{
+	if (!m_isInputFinished && m_inFlight < m_maxTokens)
+	{
+		return true;
+	}
+
+	std::lock_guard guard(m_resumableMutex);
+	return !m_resumable.empty();
+}
+
+bool Pipeline::fetchInput(Item& item)
+{
+	std::lock_guard guard(m_inputMutex);
+	if (m_isInputFinished || m_inFlight >= m_maxTokens)
+	{
+		return false;
+	}
+
+	if (!m_input(item.value))
+	{
+		m_isInputFinished = true;
+		return false;
+	}
+
+	++m_inFlight;
+	item.ticket = m_nextTicket++;
+	item.stage = 0;
+	return true;
+}
+
+bool Pipeline::popResumable(Item& item)
+{
+	std::lock_guard guard(m_resumableMutex);
+	if (m_resumable.empty())
+	{
+		return false;
+	}
+
+	item = std::move(m_resumable.front());
+	m_resumable.pop_front();
+	return true;
+}
+
+void Pipeline::process(Item& item)
+{
+	for (; item.stage < m_stages.size(); ++item.stage)
+	{
+		auto& stage = m_stages[item.stage];
+
+		switch (stage.mode)
+		{
+		case StageMode::Parallel:
+			stage.function(item.value);
+			break;
+
+		case StageMode::SerialOutOfOrder:
+		{
+			std::lock_guard guard(stage.mutex);
+			stage.function(item.value);
+			break;
+		}
+
+		case StageMode::SerialInOrder:
+		{
+			std::lock_guard guard(stage.mutex);
+			if (item.ticket != stage.nextTicket)
+			{
+				stage.parked.emplace(item.ticket, std::move(item));
+				return;
+			}
+
+			stage.function(item.value);
+			++stage.nextTicket;
+
+			auto next = stage.parked.find(stage.nextTicket);
+			if (next != stage.parked.end())
+			{
+				std::lock_guard resumableGuard(m_resumableMutex);
+				m_resumable.push_back(std::move(next->second));
+				stage.parked.erase(next);
+			}
+			break;
+		}
+		}
+	}
+
+	std::lock_guard guard(m_tokenMutex);
+	--m_inFlight;
+	m_tokenCondition.notify_one();
+}
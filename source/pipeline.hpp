@@ -0,0 +1,92 @@
+#pragma once
+#include <any>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+
+class TaskFactory;
+class TaskExecuter;
+
+enum class StageMode
+{
+	SerialInOrder,		// one item at a time, in the order the input produced them
+	SerialOutOfOrder,	// one item at a time, in any order
+	Parallel			// any number of items at once
+};
+
+// Streams items through a chain of stages, e.g. decode -> transform -> serialize.
+// A token job takes an item from the input and carries it through all stages on the same worker,
+// and at most maxTokens items are in flight. An item that reaches a SerialInOrder stage before its
+// turn is parked there and its token takes new input; the token that runs the preceding item hands
+// the parked one on. A token which finds nothing to do returns instead of holding its worker, and
+// run() starts a new one (up to maxTokens at once) whenever an item leaves the pipeline.
+class Pipeline
+{
+public:
+	// fills the item and returns true, or returns false when the input is exhausted; called serially
+	using InputFunction = std::function<bool(std::any&)>;
+	using StageFunction = std::function<void(std::any&)>;
+
+	explicit Pipeline(std::uint32_t maxTokens);
+
+	Pipeline(const Pipeline&) = delete;
+	Pipeline& operator=(const Pipeline&) = delete;
+
+	void setInput(InputFunction input);
+	void addStage(StageMode mode, StageFunction function);
+
+	// blocks until the input is exhausted and every item has passed all stages
+	void run(TaskFactory& factory, TaskExecuter& executor);
+
+private:
+	struct Item
+	{
+		std::any value;
+		std::uint64_t ticket = 0;
+		size_t stage = 0;
+	};
+
+	struct Stage
+	{
+		Stage(StageMode stageMode, StageFunction stageFunction) :
+			mode(stageMode),
+			function(std::move(stageFunction))
+		{}
+
+		StageMode mode;
+		StageFunction function;
+
+		std::mutex mutex;
+		std::uint64_t nextTicket = 0;
+		std::map<std::uint64_t, Item> parked;
+	};
+
+	void runToken();
+	bool canStartToken();
+	bool fetchInput(Item& item);
+	bool popResumable(Item& item);
+	void process(Item& item);
+
+private:
+	const std::uint32_t m_maxTokens;
+
+	InputFunction m_input;
+	std::deque<Stage> m_stages;
+
+	std::mutex m_inputMutex;
+	std::uint64_t m_nextTicket = 0;
+	std::atomic<bool> m_isInputFinished = false;
+	std::atomic<std::uint32_t> m_inFlight = 0;
+
+	std::mutex m_resumableMutex;
+	std::deque<Item> m_resumable;
+
+	// guards m_activeTokens and the wake-ups of run()
+	std::mutex m_tokenMutex;
+	std::condition_variable m_tokenCondition;
+	std::uint32_t m_activeTokens = 0;
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+
+#include "slab_allocator.hpp"
+#include "../utils/bit_utils.hpp"
+
+// Append-only array which can be filled from several threads without a lock.
+// Elements live in chunks of geometrically growing size (BaseSize, 2 * BaseSize, 4 * BaseSize, ...),
+// so an element never moves and its address stays valid until the array is destroyed.
+// allocate() reserves an index with a single fetch_add, the chunk for it is published with a CAS.
+// Chunks come from the slab allocator, the larger ones fall through to the heap.
+template<typename UnderlyingType, std::uint32_t BaseSizeLog2 = 5>
+class ChunkedArray
+{
+public:
+	ChunkedArray() noexcept
+	{
+		for (auto& chunk : m_chunks)
+		{
+			chunk.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	ChunkedArray(const ChunkedArray&) = delete;
+	ChunkedArray& operator=(const ChunkedArray&) = delete;
+
+	~ChunkedArray()
+	{
+		const size_t count = m_size.load(std::memory_order_acquire);
+		for (size_t index = 0; index < count; ++index)
+		{
+			(*this)[index].~UnderlyingType();
+		}
+
+		for (std::uint32_t chunkIndex = 0; chunkIndex < CHUNK_COUNT; ++chunkIndex)
+		{
+			if (auto* chunk = m_chunks[chunkIndex].load(std::memory_order_relaxed))
+			{
+				Detail::slabDeallocate(chunk, getChunkBytes(chunkIndex), alignof(UnderlyingType));
+			}
+		}
+	}
+
+	// reserves a slot, the caller has to construct the element before anybody reads it
+	size_t allocate()
+	{
+		const size_t index = m_size.fetch_add(1, std::memory_order_relaxed);
+		acquireChunk(getChunkIndex(index));
+		return index;
+	}
+
+	template<typename ... Args>
+	UnderlyingType& construct(size_t index, Args&&... args)
+	{
+		return *new (getAddress(index)) UnderlyingType{ std::forward<Args>(args)... };
+	}
+
+	// allocates the chunks needed for count elements in advance
+	void reserve(size_t count)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		const auto lastChunk = getChunkIndex(count - 1);
+		for (std::uint32_t chunkIndex = 0; chunkIndex <= lastChunk; ++chunkIndex)
+		{
+			acquireChunk(chunkIndex);
+		}
+	}
+
+	UnderlyingType& operator[](size_t index) noexcept
+	{
+		return *std::launder(reinterpret_cast<UnderlyingType*>(getAddress(index)));
+	}
+
+	const UnderlyingType& operator[](size_t index) const noexcept
+	{
+		return *std::launder(reinterpret_cast<const UnderlyingType*>(const_cast<ChunkedArray*>(this)->getAddress(index)));
+	}
+
+	size_t size() const noexcept
+	{
+		return m_size.load(std::memory_order_acquire);
+	}
+
+private:
+	using StorageType = std::aligned_storage_t<sizeof(UnderlyingType), alignof(UnderlyingType)>;
+
+	static constexpr size_t BASE_SIZE = size_t(1) << BaseSizeLog2;
+	static constexpr std::uint32_t CHUNK_COUNT = 64 - BaseSizeLog2;
+
+	static std::uint32_t getChunkIndex(size_t index) noexcept
+	{
+		return Detail::highestBit(index + BASE_SIZE) - BaseSizeLog2;
+	}
+
+	static size_t getChunkSize(std::uint32_t chunkIndex) noexcept
+	{
+		return BASE_SIZE << chunkIndex;
+	}
+
+	static size_t getChunkBytes(std::uint32_t chunkIndex) noexcept
+	{
+		return sizeof(StorageType) * getChunkSize(chunkIndex);
+	}
+
+	void* getAddress(size_t index) noexcept
+	{
+		const auto bit = Detail::highestBit(index + BASE_SIZE);
+		const auto offset = index + BASE_SIZE - (size_t(1) << bit);
+		auto* chunk = m_chunks[bit - BaseSizeLog2].load(std::memory_order_acquire);
+		assert(chunk);
+		return &chunk[offset];
+	}
+
+	void acquireChunk(std::uint32_t chunkIndex)
+	{
+		assert(chunkIndex < CHUNK_COUNT);
+		if (m_chunks[chunkIndex].load(std::memory_order_acquire))
+		{
+			return;
+		}
+
+		auto* chunk = static_cast<StorageType*>(Detail::slabAllocate(getChunkBytes(chunkIndex), alignof(UnderlyingType)));
+
+		StorageType* expected = nullptr;
+		if (!m_chunks[chunkIndex].compare_exchange_strong(expected, chunk, std::memory_order_acq_rel))
+		{
+			// another thread has published the chunk first
+			Detail::slabDeallocate(chunk, getChunkBytes(chunkIndex), alignof(UnderlyingType));
+		}
+	}
+
+private:
+	std::array<std::atomic<StorageType*>, CHUNK_COUNT> m_chunks;
+	std::atomic<size_t> m_size = 0;
+};
@@ -1,9 +1,12 @@
 #pragma once
-#include <array>
+#include <cassert>
 #include <queue>
 #include <cstdint>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
 
 template<typename T>
 struct HandleArrayItemTraits
@@ -11,15 +14,17 @@ struct HandleArrayItemTraits
 	static constexpr bool isStoredId = false;
 };
 
-template<typename UnderlyingType, typename HandleType, std::uint32_t size>
+// the number of slots is chosen at runtime, all of them are allocated up front
+template<typename UnderlyingType, typename HandleType>
 class HandleArray
 {
 public:
-	HandleArray() :
+	explicit HandleArray(std::uint32_t size) :
+		m_storage{ std::make_unique<StorageType[]>(size) },
 		m_handleMutex{},
-		m_storage{},
 		m_freeHandles{}
 	{
+		assert(size != 0 && size - 1 <= std::numeric_limits<HandleType>::max());
 		for (std::uint32_t index = 0; index < size; ++index)
 			m_freeHandles.push(static_cast<HandleType>(index)); //to many allocation ((((
 	}
@@ -55,6 +60,28 @@ public:
 	}
 
 
+	// returns std::nullopt instead of running out of handles
+	template<typename ... Args>
+	std::optional<HandleType> tryEmplace(Args&&... args)
+	{
+		auto handle = tryGetFreeHandle();
+		if (!handle)
+		{
+			return std::nullopt;
+		}
+
+		if constexpr ( HandleArrayItemTraits<UnderlyingType>::isStoredId )
+		{
+			new (&m_storage[*handle]) UnderlyingType{ *handle, std::forward<Args>(args)... };
+		}
+		else
+		{
+			new (&m_storage[*handle]) UnderlyingType{ std::forward<Args>(args)... };
+		}
+
+		return handle;
+	}
+
 	void free(const HandleType& handle)
 	{
 		auto& obj = *std::launder(reinterpret_cast<UnderlyingType*>(&m_storage[handle]));
@@ -71,6 +98,19 @@ private:
 		return handle;
 	}
 
+	std::optional<HandleType> tryGetFreeHandle()
+	{
+		std::lock_guard guard(m_handleMutex);
+		if (m_freeHandles.empty())
+		{
+			return std::nullopt;
+		}
+
+		auto handle = m_freeHandles.front();
+		m_freeHandles.pop();
+		return handle;
+	}
+
 	void putHandleToFree(const HandleType& handle)
 	{
 		std::lock_guard guard(m_handleMutex);
@@ -80,7 +120,7 @@ private:
 private:
 	using StorageType = std::aligned_storage_t<sizeof(UnderlyingType), alignof(UnderlyingType)>;
 
-	std::array< StorageType, size > m_storage;
+	std::unique_ptr<StorageType[]> m_storage;
 	std::mutex m_handleMutex;
 	std::queue<HandleType> m_freeHandles;
 };
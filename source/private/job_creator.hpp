@@ -1,6 +1,11 @@
 #pragma once
 #include <memory>
 #include <any>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "../config.hpp"
 
 namespace Detail
 {
@@ -33,7 +38,50 @@ namespace Detail
 
 	template<typename PacketTaskType>
 	struct JobCreator : public JobCreatorImpl<PacketTaskType, typename PacketTaskType::ResultType>
-	{};
+	{
+		// running average of the measured execution time of this job type, 0 until the first run
+		static std::atomic<std::uint64_t>* getCostEstimate()
+		{
+			static std::atomic<std::uint64_t> estimate = 0;
+			return &estimate;
+		}
+	};
+
+	struct CostEstimateSlot
+	{
+		const std::atomic<std::uint64_t>* estimate = nullptr;
+		std::uint64_t average = 0;
+	};
+
+	inline void updateCostEstimate(std::atomic<std::uint64_t>* estimate, std::uint64_t duration)
+	{
+		if (!estimate)
+		{
+			return;
+		}
+
+		// the estimate is shared by every task of the job type; each thread keeps its own running
+		// average in a small direct-mapped table and publishes it only when the published value is
+		// off noticeably, so the cache line stays shared between the workers while the durations are
+		// stable. A job type evicted from its slot starts again from the published value, and a lost
+		// store only drops one publication, so a plain load/store is enough.
+		thread_local std::array<CostEstimateSlot, COST_ESTIMATE_SLOT_COUNT> slots;
+
+		const auto published = estimate->load(std::memory_order_relaxed);
+		auto& slot = slots[reinterpret_cast<std::uintptr_t>(estimate) / sizeof(*estimate) % slots.size()];
+		if (slot.estimate != estimate)
+		{
+			slot.estimate = estimate;
+			slot.average = published;
+		}
+
+		slot.average = slot.average == 0 ? duration : (slot.average * 7 + duration) / 8;
+		const auto change = slot.average > published ? slot.average - published : published - slot.average;
+		if (published == 0 || change > (published >> COST_ESTIMATE_TOLERANCE_LOG2))
+		{
+			estimate->store(slot.average, std::memory_order_relaxed);
+		}
+	}
 
 
 	template<typename Callable, typename ... Args>
@@ -42,10 +90,11 @@ namespace Detail
 		using CallableType = Callable;
 		using ResultType = std::invoke_result_t<Callable, Args...>;
 
-		template<typename Callable, typename ... Args>
-		PacketTask(Callable&& f, Args&&... args) :
-			callable(std::forward<Callable>(f)),
-			arguments(std::forward<Args>(args)...)
+		// own parameter names, redeclaring the ones of the class template is ill-formed
+		template<typename CallableArg, typename ... ArgTypes>
+		PacketTask(CallableArg&& f, ArgTypes&&... args) :
+			callable(std::forward<CallableArg>(f)),
+			arguments(std::forward<ArgTypes>(args)...)
 		{}
 
 		CallableType callable;
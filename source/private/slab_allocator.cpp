@@ -0,0 +1,303 @@
+#include "slab_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "../utils/bit_utils.hpp"
+
+namespace Detail
+{
+	namespace
+	{
+		constexpr std::size_t PAGE_SIZE = 4096;
+		constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+		std::size_t alignUp(std::size_t value, std::size_t alignment) noexcept
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		std::byte* mapRegion(std::size_t size, bool useHugePages, bool& isHugePages)
+		{
+			isHugePages = false;
+#if defined(_WIN32)
+			if (useHugePages)
+			{
+				// needs the "lock pages in memory" privilege, otherwise fall back to normal pages
+				const auto largePageSize = GetLargePageMinimum();
+				if (largePageSize != 0)
+				{
+					if (auto* region = VirtualAlloc(nullptr, alignUp(size, largePageSize), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE))
+					{
+						isHugePages = true;
+						return static_cast<std::byte*>(region);
+					}
+				}
+			}
+
+			return static_cast<std::byte*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+			auto* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (region == MAP_FAILED)
+			{
+				return nullptr;
+			}
+
+#if defined(MADV_HUGEPAGE)
+			// transparent huge pages, only a hint to the kernel
+			if (useHugePages)
+			{
+				isHugePages = madvise(region, size, MADV_HUGEPAGE) == 0;
+			}
+#endif
+			return static_cast<std::byte*>(region);
+#endif
+		}
+
+		void unmapRegion(std::byte* region, std::size_t size) noexcept
+		{
+#if defined(_WIN32)
+			(void)size;
+			VirtualFree(region, 0, MEM_RELEASE);
+#else
+			munmap(region, size);
+#endif
+		}
+	}
+
+	SlabAllocator& SlabAllocator::getInstance()
+	{
+		static SlabAllocator instance;
+		return instance;
+	}
+
+	SlabAllocator::~SlabAllocator()
+	{
+		if (auto* region = m_region.load(std::memory_order_relaxed))
+		{
+			unmapRegion(region, m_regionSize);
+		}
+	}
+
+	void SlabAllocator::initialize(const SchedulerConfig& config)
+	{
+		std::lock_guard guard(m_initializeMutex);
+		if (m_region.load(std::memory_order_relaxed) || config.slabMemorySize == 0)
+		{
+			return;
+		}
+
+		const auto size = alignUp(config.slabMemorySize, config.useHugePages ? HUGE_PAGE_SIZE : PAGE_SIZE);
+		auto* region = mapRegion(size, config.useHugePages, m_isHugePages);
+		if (!region)
+		{
+			// everything keeps coming from the heap
+			return;
+		}
+
+		if (config.prefaultMemory)
+		{
+			// touch every page now instead of faulting on the first allocations
+			for (std::size_t offset = 0; offset < size; offset += PAGE_SIZE)
+			{
+				static_cast<volatile std::byte*>(region)[offset] = std::byte{ 0 };
+			}
+		}
+
+		m_regionSize = size;
+		m_region.store(region, std::memory_order_release);
+	}
+
+	void* SlabAllocator::allocate(std::size_t size, std::size_t alignment)
+	{
+		if (size > SLAB_MAX_BLOCK_SIZE || alignment > CACHE_LINE_SIZE || !m_region.load(std::memory_order_acquire))
+		{
+			return ::operator new(size, std::align_val_t(alignment));
+		}
+
+		const auto classIndex = getClassIndex(std::max(size, alignment));
+		auto& cache = getThreadCache();
+		if (!cache.blocks[classIndex] && !refill(cache, classIndex))
+		{
+			return ::operator new(size, std::align_val_t(alignment));
+		}
+
+		auto* block = cache.blocks[classIndex];
+		cache.blocks[classIndex] = block->next;
+		--cache.counts[classIndex];
+		return block;
+	}
+
+	void SlabAllocator::deallocate(void* pointer, std::size_t size, std::size_t alignment) noexcept
+	{
+		if (!isInRegion(pointer))
+		{
+			::operator delete(pointer, std::align_val_t(alignment));
+			return;
+		}
+
+		const auto classIndex = getClassIndex(std::max(size, alignment));
+		auto& cache = getThreadCache();
+
+		auto* block = static_cast<FreeBlock*>(pointer);
+		block->next = cache.blocks[classIndex];
+		cache.blocks[classIndex] = block;
+
+		// a thread which frees more than it allocates hands the surplus back in one batch
+		const auto batchSize = getBatchSize(classIndex);
+		if (++cache.counts[classIndex] >= 2 * batchSize)
+		{
+			flush(cache, classIndex, batchSize);
+		}
+	}
+
+	std::size_t SlabAllocator::getUsedSize() const noexcept
+	{
+		return m_usedSize.load(std::memory_order_relaxed);
+	}
+
+	std::size_t SlabAllocator::getRegionSize() const noexcept
+	{
+		return m_region.load(std::memory_order_acquire) ? m_regionSize : 0;
+	}
+
+	bool SlabAllocator::isUsingHugePages() const noexcept
+	{
+		return m_isHugePages;
+	}
+
+	SlabAllocator::ThreadCache::~ThreadCache()
+	{
+		auto& allocator = getInstance();
+		for (std::uint32_t classIndex = 0; classIndex < SLAB_CLASS_COUNT; ++classIndex)
+		{
+			allocator.flush(*this, classIndex, counts[classIndex]);
+		}
+	}
+
+	std::uint32_t SlabAllocator::getClassIndex(std::size_t size) noexcept
+	{
+		constexpr std::size_t minBlockSize = std::size_t(1) << SLAB_MIN_BLOCK_SIZE_LOG2;
+		if (size <= minBlockSize)
+		{
+			return 0;
+		}
+
+		return highestBit(size - 1) + 1 - SLAB_MIN_BLOCK_SIZE_LOG2;
+	}
+
+	std::size_t SlabAllocator::getClassSize(std::uint32_t classIndex) noexcept
+	{
+		return std::size_t(1) << (classIndex + SLAB_MIN_BLOCK_SIZE_LOG2);
+	}
+
+	std::uint32_t SlabAllocator::getBatchSize(std::uint32_t classIndex) noexcept
+	{
+		const auto count = SLAB_CACHE_SIZE / getClassSize(classIndex);
+		return static_cast<std::uint32_t>(std::clamp<std::size_t>(count, 1, SLAB_MAX_BATCH_SIZE));
+	}
+
+	SlabAllocator::ThreadCache& SlabAllocator::getThreadCache()
+	{
+		thread_local ThreadCache cache;
+		return cache;
+	}
+
+	bool SlabAllocator::isInRegion(const void* pointer) const noexcept
+	{
+		const auto* region = m_region.load(std::memory_order_acquire);
+		const auto* address = static_cast<const std::byte*>(pointer);
+		return region && address >= region && address < region + m_regionSize;
+	}
+
+	bool SlabAllocator::refill(ThreadCache& cache, std::uint32_t classIndex)
+	{
+		const auto batchSize = getBatchSize(classIndex);
+		auto& sizeClass = m_classes[classIndex];
+		{
+			std::lock_guard guard(sizeClass.mutex);
+			std::uint32_t count = 0;
+			while (sizeClass.freeList && count < batchSize)
+			{
+				auto* block = sizeClass.freeList;
+				sizeClass.freeList = block->next;
+
+				block->next = cache.blocks[classIndex];
+				cache.blocks[classIndex] = block;
+				++count;
+			}
+
+			cache.counts[classIndex] += count;
+			if (count != 0)
+			{
+				return true;
+			}
+		}
+
+		// nothing to reuse, carve a new batch off the region
+		const auto classSize = getClassSize(classIndex);
+		const auto alignment = std::min(classSize, CACHE_LINE_SIZE);
+
+		std::size_t offset = 0;
+		std::size_t count = 0;
+		auto used = m_usedSize.load(std::memory_order_relaxed);
+		do
+		{
+			offset = alignUp(used, alignment);
+			if (offset >= m_regionSize)
+			{
+				return false;
+			}
+
+			count = std::min<std::size_t>(batchSize, (m_regionSize - offset) / classSize);
+			if (count == 0)
+			{
+				return false;
+			}
+		} while (!m_usedSize.compare_exchange_weak(used, offset + count * classSize, std::memory_order_relaxed));
+
+		auto* region = m_region.load(std::memory_order_relaxed);
+		for (std::size_t index = 0; index < count; ++index)
+		{
+			auto* block = reinterpret_cast<FreeBlock*>(region + offset + index * classSize);
+			block->next = cache.blocks[classIndex];
+			cache.blocks[classIndex] = block;
+		}
+
+		cache.counts[classIndex] += static_cast<std::uint32_t>(count);
+		return true;
+	}
+
+	void SlabAllocator::flush(ThreadCache& cache, std::uint32_t classIndex, std::uint32_t count) noexcept
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		// detach the first count blocks as one list and splice it into the shared list
+		auto* first = cache.blocks[classIndex];
+		auto* last = first;
+		for (std::uint32_t index = 1; index < count; ++index)
+		{
+			last = last->next;
+		}
+
+		cache.blocks[classIndex] = last->next;
+		cache.counts[classIndex] -= count;
+
+		auto& sizeClass = m_classes[classIndex];
+		std::lock_guard guard(sizeClass.mutex);
+		last->next = sizeClass.freeList;
+		sizeClass.freeList = first;
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include "../config.hpp"
+
+namespace Detail
+{
+	// Scheduler-wide allocator for task nodes, edges and job payloads.
+	// Memory comes from one region mapped at startup (optionally pre-faulted or backed by huge pages)
+	// and is handed out in power-of-two size classes. Every thread keeps a small cache per class,
+	// refilled from and flushed to the shared free lists in batches, so the steady state
+	// neither takes a lock nor touches the heap. Blocks above SLAB_MAX_BLOCK_SIZE, alignments above
+	// CACHE_LINE_SIZE and requests after the region is used up go to the general heap.
+	class SlabAllocator
+	{
+	public:
+		static SlabAllocator& getInstance();
+
+		// maps the region; only the first call has an effect, later ones keep the existing region
+		void initialize(const SchedulerConfig& config);
+
+		void* allocate(std::size_t size, std::size_t alignment);
+		void deallocate(void* pointer, std::size_t size, std::size_t alignment) noexcept;
+
+		// bytes of the region handed out to size classes so far
+		std::size_t getUsedSize() const noexcept;
+		std::size_t getRegionSize() const noexcept;
+		bool isUsingHugePages() const noexcept;
+
+	private:
+		struct FreeBlock
+		{
+			FreeBlock* next;
+		};
+
+		struct SizeClass
+		{
+			std::mutex mutex;
+			FreeBlock* freeList = nullptr;
+		};
+
+		struct ThreadCache
+		{
+			~ThreadCache();
+
+			std::array<FreeBlock*, SLAB_CLASS_COUNT> blocks = {};
+			std::array<std::uint32_t, SLAB_CLASS_COUNT> counts = {};
+		};
+
+		SlabAllocator() = default;
+		~SlabAllocator();
+
+		static std::uint32_t getClassIndex(std::size_t size) noexcept;
+		static std::size_t getClassSize(std::uint32_t classIndex) noexcept;
+		static std::uint32_t getBatchSize(std::uint32_t classIndex) noexcept;
+		static ThreadCache& getThreadCache();
+
+		bool isInRegion(const void* pointer) const noexcept;
+		bool refill(ThreadCache& cache, std::uint32_t classIndex);
+		void flush(ThreadCache& cache, std::uint32_t classIndex, std::uint32_t count) noexcept;
+
+	private:
+		std::mutex m_initializeMutex;
+		std::atomic<std::byte*> m_region = nullptr;
+		std::size_t m_regionSize = 0;
+		bool m_isHugePages = false;
+		std::atomic<std::size_t> m_usedSize = 0;
+
+		std::array<SizeClass, SLAB_CLASS_COUNT> m_classes;
+	};
+
+	inline void* slabAllocate(std::size_t size, std::size_t alignment)
+	{
+		return SlabAllocator::getInstance().allocate(size, alignment);
+	}
+
+	inline void slabDeallocate(void* pointer, std::size_t size, std::size_t alignment) noexcept
+	{
+		SlabAllocator::getInstance().deallocate(pointer, size, alignment);
+	}
+
+	// std allocator over the slab, e.g. for std::allocate_shared
+	template<typename T>
+	struct SlabStdAllocator
+	{
+		using value_type = T;
+
+		SlabStdAllocator() noexcept = default;
+
+		template<typename Other>
+		SlabStdAllocator(const SlabStdAllocator<Other>&) noexcept
+		{}
+
+		T* allocate(std::size_t count)
+		{
+			return static_cast<T*>(slabAllocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* pointer, std::size_t count) noexcept
+		{
+			slabDeallocate(pointer, count * sizeof(T), alignof(T));
+		}
+
+		template<typename Other>
+		bool operator==(const SlabStdAllocator<Other>&) const noexcept
+		{
+			return true;
+		}
+
+		template<typename Other>
+		bool operator!=(const SlabStdAllocator<Other>&) const noexcept
+		{
+			return false;
+		}
+	};
+}
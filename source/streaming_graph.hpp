@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "task_factory.hpp"
+#include "task_executor.hpp"
+
+// Graphs which run while they are built, for batches too large to be built and sorted before the
+// first job starts. The group is pushed to the executor right away and has no rounds: a node is
+// queued in the group's ready queue as soon as it is added and its parents have finished, and the
+// workers take it from there. Nodes are stored in sections of Detail::STREAM_SECTION_SIZE which
+// are released once all of their nodes have finished, so the memory follows the part of the
+// graph which is still running or waiting instead of its whole size.
+//
+//     StreamingGraph graph(factory, executor);
+//     auto load = graph.addNode(loadChunk, 0);
+//     graph.addNodeAfter({ load }, processChunk, 0);
+//     graph.wait();
+//
+// Parents have to be added before their children, so the graph is acyclic by construction.
+// Nodes are added from one thread only. A node is not a Task, results go through the captured state.
+// The scheduling policy of the executor does not apply, ready nodes are taken in FIFO order.
+class StreamingGraph
+{
+public:
+	using NodeID = size_t;
+
+	StreamingGraph(TaskFactory& factory, TaskExecuter& executor, TaskExecuter::ArenaID arena = TaskExecuter::DEFAULT_ARENA) :
+		m_group(factory.createStreamingGroup()),
+		m_executor(executor),
+		m_arena(arena)
+	{
+		// the graph keeps the group alive, the group's own reference is dropped when it finishes
+		m_group.increaseReferenceCount();
+		m_executor.push(m_group, arena);
+	}
+
+	StreamingGraph(const StreamingGraph&) = delete;
+	StreamingGraph& operator=(const StreamingGraph&) = delete;
+
+	// closes the graph but does not wait for it
+	~StreamingGraph()
+	{
+		close();
+		m_group.decreaseReferenceCount();
+	}
+
+	template<typename Callable, typename ... Args>
+	NodeID addNode(Callable&& callable, Args&&... args)
+	{
+		return add(nullptr, 0, std::forward<Callable>(callable), std::forward<Args>(args)...);
+	}
+
+	// the node runs after all of the parents, e.g. addNodeAfter({ load, decode }, ...)
+	template<typename Callable, typename ... Args>
+	NodeID addNodeAfter(std::initializer_list<NodeID> parents, Callable&& callable, Args&&... args)
+	{
+		return add(parents.begin(), parents.size(), std::forward<Callable>(callable), std::forward<Args>(args)...);
+	}
+
+	template<typename Callable, typename ... Args>
+	NodeID addNodeAfter(const std::vector<NodeID>& parents, Callable&& callable, Args&&... args)
+	{
+		return add(parents.data(), parents.size(), std::forward<Callable>(callable), std::forward<Args>(args)...);
+	}
+
+	// no more nodes are added
+	void close()
+	{
+		if (!m_isClosed)
+		{
+			m_isClosed = true;
+			m_group.closeStream();
+
+			// the queue lets go of a finished group only when a worker passes over it
+			m_executor.wakeWorker(m_arena);
+		}
+	}
+
+	// closes the graph and blocks until all of its nodes have finished;
+	// like Task::wait it must not be called from a job running on the same executor
+	void wait()
+	{
+		close();
+		m_group.waitStream();
+	}
+
+private:
+	template<typename Callable, typename ... Args>
+	NodeID add(const NodeID* parents, size_t parentCount, Callable&& callable, Args&&... args)
+	{
+		auto& node = m_group.addStreamingNode(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		if (m_group.linkStreamingNode(node, parents, parentCount))
+		{
+			// workers finding the group empty may have gone to sleep, one of them takes the node
+			m_executor.wakeWorker(m_arena);
+		}
+
+		return node.getID();
+	}
+
+private:
+	TaskGroup& m_group;
+	TaskExecuter& m_executor;
+	const TaskExecuter::ArenaID m_arena;
+	bool m_isClosed = false;
+};
@@ -9,6 +9,7 @@
 
 #include "task_group.hpp"
 #include "task_executor.hpp"
+#include "thread_mailbox.hpp"
 
 
 template<typename ReturnedType>
@@ -32,7 +33,10 @@ public:
 	Task(const Task& other) noexcept :
 		m_taskNode(other.m_taskNode)
 	{
-		m_taskNode->getGroup().increaseReferenceCount();
+		if (m_taskNode)
+		{
+			m_taskNode->getGroup().increaseReferenceCount();
+		}
 	}
 
 	Task(Task&& other) noexcept :
@@ -49,7 +53,7 @@ public:
 		}
 	}
 
-	Task& operator=(Task& other) noexcept
+	Task& operator=(const Task& other) noexcept
 	{
 		if (&other != this)
 		{
@@ -59,44 +63,144 @@ public:
 			}
 
 			m_taskNode = other.m_taskNode;
-			m_taskNode->getGroup().increaseReferenceCount();
+			if (m_taskNode)
+			{
+				m_taskNode->getGroup().increaseReferenceCount();
+			}
 		}
 
 		return *this;
 	}
 
+	// the continuation joins the group of the task; once that group has been submitted it can no
+	// longer grow, then the continuation starts a new group and the task releases it when it finishes
 	template<typename Callable, typename ... Args>
 	auto then(Callable&& callable, Args&&... args)
 	{
-		auto& group = m_taskNode->getGroup();
+		auto* group = &m_taskNode->getGroup();
+		const bool isSubmitted = group->isSubmitted();
+		if (isSubmitted)
+		{
+			group = &group->createFollowUpGroup();
+		}
 
-		auto nodeID = group.addNode(std::forward<Callable>(callable), *this, std::forward<Args>(args)...);
-		group.link(m_taskNode->getID(),nodeID);
+		auto nodeID = group->addNode(std::forward<Callable>(callable), *this, std::forward<Args>(args)...);
+		auto* taskNode = group->getTaskNode(nodeID);
+		if (isSubmitted)
+		{
+			TaskGroup::addFollowUp(*m_taskNode, *taskNode);
+		}
+		else
+		{
+			group->link(m_taskNode->getID(), nodeID);
+		}
 
-		auto* taskNode = group.getTaskNode(nodeID);
 		return Task< std::invoke_result_t<Callable, std::add_lvalue_reference_t< std::remove_pointer_t< decltype(this) >, Args...> > >(taskNode);
 	}
 
+	// the continuation prefers the worker chosen by the affinity key
+	template<typename Callable, typename ... Args>
+	auto then(Affinity affinity, Callable&& callable, Args&&... args)
+	{
+		auto task = then(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		task.m_taskNode->setAffinity(affinity.key);
+		return task;
+	}
+
+	// the continuation runs on the thread owning the mailbox when it pumps
+	template<typename Callable, typename ... Args>
+	auto then(OnThread thread, Callable&& callable, Args&&... args)
+	{
+		assert(thread.mailbox);
+		auto task = then(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		task.m_taskNode->setMailbox(thread.mailbox);
+		return task;
+	}
+
+	// expected execution time in nanoseconds, used to prioritise the longest dependent chains;
+	// has to be set before the task is submitted
+	Task& setCostHint(std::uint64_t cost) noexcept
+	{
+		assert(m_taskNode);
+		m_taskNode->setCost(cost);
+		return *this;
+	}
+
 	template<typename Type_ = ReturnedType>
 	[[nodiscard]]
 	typename std::enable_if_t< !std::is_same<Type_, void>::value, Type_ > get()
 	{
 		assert(m_taskNode);
-		return std::any_cast<ReturnedType>(m_taskNode->getReturnedValue());
+		return std::any_cast<ReturnedType>(m_taskNode->getValue().returnedValue);
 	}
 
 	template<typename Type_ = ReturnedType>
 	typename std::enable_if_t< std::is_same<Type_, void>::value > get()
 	{}
 
+	// queues the whole group of the task in the arena without waiting for it
+	void submit(TaskExecuter& executor, TaskExecuter::ArenaID arena = TaskExecuter::DEFAULT_ARENA)
+	{
+		assert(m_taskNode);
+		m_taskNode->submit(executor, arena);
+	}
+
+	// like submit, but give up instead of blocking when the executor's in-flight limit is reached
+	bool trySubmit(TaskExecuter& executor, TaskExecuter::ArenaID arena = TaskExecuter::DEFAULT_ARENA)
+	{
+		assert(m_taskNode);
+		return m_taskNode->trySubmit(executor, arena);
+	}
+
+	bool submitFor(TaskExecuter& executor, std::chrono::nanoseconds timeout, TaskExecuter::ArenaID arena = TaskExecuter::DEFAULT_ARENA)
+	{
+		assert(m_taskNode);
+		return m_taskNode->submitFor(executor, timeout, arena);
+	}
+
 	void wait(TaskExecuter& executor)
 	{
 		assert(m_taskNode);
 		m_taskNode->wait(executor);
 	}
 
+	// false for a default constructed task and for a failed TaskFactory::tryCreateTask
+	bool isValid() const noexcept
+	{
+		return m_taskNode != nullptr;
+	}
+
+	bool isFinished() const
+	{
+		assert(m_taskNode);
+		return m_taskNode->isFinished();
+	}
+
+	// when the task became ready, started and finished; queue latency and execution time follow from it
+	TaskProfile getProfile() const
+	{
+		assert(m_taskNode && m_taskNode->isFinished());
+		return m_taskNode->getProfile();
+	}
+
+	GroupProfile getGroupProfile() const
+	{
+		assert(m_taskNode);
+		return m_taskNode->getGroup().getProfile();
+	}
+
+	// see TaskNode::setContinuation
+	bool setContinuation(TaskContinuation& continuation)
+	{
+		assert(m_taskNode);
+		return m_taskNode->setContinuation(continuation);
+	}
+
 private:
 	friend class TaskExecuter;
 
+	template<typename OtherType>
+	friend class Task;
+
 	TaskGroup::NodeType* m_taskNode;
 };
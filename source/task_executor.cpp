@@ -1,52 +1,507 @@
 #include "task_executor.hpp"
 
+#include <cassert>
+
+#include "task_group.hpp"
+#include "utils/time_utils.hpp"
+
+namespace
+{
+	thread_local const TaskExecuter* t_executor = nullptr;
+	thread_local std::uint16_t t_workerIndex = TaskExecuter::INVALID_WORKER_INDEX;
+}
+
 TaskExecuter::TaskExecuter(std::uint16_t threadCount) :
-	m_semaphore(threadCount),
-	m_threadCount(threadCount),
+	TaskExecuter(threadCount, threadCount)
+{
+};
+
+TaskExecuter::TaskExecuter(std::uint16_t minThreadCount, std::uint16_t maxThreadCount, std::chrono::milliseconds idleTimeout) :
+	m_threadCount(maxThreadCount),
+	m_idleTimeout(idleTimeout),
+	m_metrics(maxThreadCount + Detail::MAX_HELPER_COUNT),
 	m_isEnabled(true)
 {
-	m_workers.reserve(threadCount);
+	assert(minThreadCount <= maxThreadCount && maxThreadCount > 0);
+	m_workers.resize(maxThreadCount);
+	m_isWorkerActive.resize(maxThreadCount, false);
+
+	m_arenas[DEFAULT_ARENA] = std::make_unique<Arena>("default", minThreadCount, maxThreadCount, false, maxThreadCount, &m_metrics, &m_inFlightGroups);
+	m_arenaCount = 1;
+
 	initializeWorkers();
 };
 
 TaskExecuter::~TaskExecuter()
 {
 	m_isEnabled = false;
-	m_semaphore.notifyAll();
-	std::for_each(m_workers.begin(), m_workers.end(), [](auto& worker) { worker.join(); });
+	for (std::uint16_t index = 0; index < getArenaCount(); ++index)
+	{
+		m_arenas[index]->semaphore.notifyAll();
+	}
+
+	// workers may still need the mutex to retire, so they are joined outside of it
+	std::vector<std::thread> workers;
+	{
+		std::lock_guard guard(m_workersMutex);
+		workers.swap(m_workers);
+	}
+
+	std::for_each(workers.begin(), workers.end(), [](auto& worker)
+	{
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	});
+}
+
+void TaskExecuter::push(TaskGroup& group, ArenaID arenaId)
+{
+	if (group.isSubmitted())
+	{
+		return;
+	}
+
+	// groups spawned from inside a task are never held back: their parent group keeps its
+	// in-flight slot until they have been pushed, so waiting for a slot there could wait forever
+	if (TaskGroup::isInsideTask())
+	{
+		++m_inFlightGroups;
+		pushAdmitted(group, arenaId);
+		return;
+	}
+
+	while (!tryAdmit())
+	{
+		// run tasks meanwhile instead of only waiting
+		if (!helpExecute(arenaId))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	pushAdmitted(group, arenaId);
+}
+
+bool TaskExecuter::tryPush(TaskGroup& group, ArenaID arenaId)
+{
+	if (group.isSubmitted())
+	{
+		return true;
+	}
+
+	if (!tryAdmit())
+	{
+		return false;
+	}
+
+	pushAdmitted(group, arenaId);
+	return true;
+}
+
+bool TaskExecuter::pushFor(TaskGroup& group, std::chrono::nanoseconds timeout, ArenaID arenaId)
+{
+	if (group.isSubmitted())
+	{
+		return true;
+	}
+
+	const auto deadline = getTimestamp() + static_cast<std::uint64_t>(timeout.count());
+	while (!tryAdmit())
+	{
+		// no helping here, a task run by the caller could take longer than the timeout
+		if (getTimestamp() >= deadline)
+		{
+			return false;
+		}
+
+		std::this_thread::yield();
+	}
+
+	pushAdmitted(group, arenaId);
+	return true;
+}
+
+void TaskExecuter::setMaxInFlightGroups(std::uint32_t maxInFlightGroups) noexcept
+{
+	m_maxInFlightGroups = maxInFlightGroups;
+}
+
+std::uint32_t TaskExecuter::getInFlightGroupCount() const noexcept
+{
+	return m_inFlightGroups;
+}
+
+bool TaskExecuter::tryAdmit()
+{
+	const auto maxInFlightGroups = m_maxInFlightGroups.load(std::memory_order_relaxed);
+	auto inFlightGroups = m_inFlightGroups.load(std::memory_order_relaxed);
+	do
+	{
+		if (maxInFlightGroups != 0 && inFlightGroups >= maxInFlightGroups)
+		{
+			return false;
+		}
+	}
+	while (!m_inFlightGroups.compare_exchange_weak(inFlightGroups, inFlightGroups + 1, std::memory_order_acq_rel));
+
+	return true;
+}
+
+bool TaskExecuter::helpExecute(ArenaID arenaId)
+{
+	assert(arenaId < getArenaCount());
+
+	// the task sees the helper slot as its worker index, so per-thread state such as WorkerLocal
+	// and the metrics is never shared with another thread
+	std::uint16_t helperIndex = 0;
+	while (helperIndex < Detail::MAX_HELPER_COUNT && m_isHelperSlotTaken[helperIndex].exchange(true, std::memory_order_acquire))
+	{
+		++helperIndex;
+	}
+
+	if (helperIndex == Detail::MAX_HELPER_COUNT)
+	{
+		return false;
+	}
+
+	const auto* previousExecutor = t_executor;
+	const auto previousWorkerIndex = t_workerIndex;
+	t_executor = this;
+	t_workerIndex = m_threadCount + helperIndex;
+
+	// only the arena pushed to, groups of other arenas are kept from threads outside of them
+	auto& arena = *m_arenas[arenaId];
+	const bool hasExecuted = arena.queue.execute(t_workerIndex, INVALID_WORKER_INDEX, arena.maxThreadCount);
+
+	t_executor = previousExecutor;
+	t_workerIndex = previousWorkerIndex;
+	m_isHelperSlotTaken[helperIndex].store(false, std::memory_order_release);
+
+	if (hasExecuted)
+	{
+		arena.semaphore.notifyAll();
+	}
+	return hasExecuted;
 }
 
-void TaskExecuter::push(TaskGroup& group)
+bool TaskExecuter::pushAdmitted(TaskGroup& group, ArenaID arenaId)
 {
-	m_highPriorityQueue.push(&group);
-	m_semaphore.notifyAll();
+	assert(arenaId < getArenaCount());
+	auto& arena = *m_arenas[arenaId];
+
+	if (!arena.queue.push(&group, m_policy))
+	{
+		// another thread has pushed the group in the meantime
+		--m_inFlightGroups;
+		return false;
+	}
+
+	arena.semaphore.notifyAll();
+	trySpawnWorker(arenaId);
+
+	if (arena.idleThreadCount == 0)
+	{
+		wakeLenders(arenaId);
+	}
+
+	return true;
 }
 
 void TaskExecuter::wait()
 {
-	while (m_highPriorityQueue.getSize() != 0)
+	for (std::uint16_t index = 0; index < getArenaCount(); ++index)
+	{
+		while (m_arenas[index]->queue.getSize() != 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void TaskExecuter::wakeWorkers()
+{
+	for (std::uint16_t index = 0; index < getArenaCount(); ++index)
+	{
+		m_arenas[index]->semaphore.notifyAll();
+	}
+}
+
+void TaskExecuter::wakeWorker(ArenaID arenaId)
+{
+	assert(arenaId < getArenaCount());
+	m_arenas[arenaId]->semaphore.notify();
+}
+
+TaskExecuter::ArenaID TaskExecuter::createArena(const std::string& name, std::uint16_t reservedThreadCount, bool canLendWorkers)
+{
+	assert(reservedThreadCount > 0);
+
+	std::unique_lock lock(m_workersMutex);
+	assert(getArenaCount() < Detail::MAX_ARENA_COUNT);
+	assert(findArena(name) == INVALID_ARENA);
+
+	// the default arena keeps at least one worker
+	auto& defaultArena = *m_arenas[DEFAULT_ARENA];
+	assert(defaultArena.maxThreadCount > reservedThreadCount);
+	defaultArena.maxThreadCount -= reservedThreadCount;
+	defaultArena.minThreadCount = std::min(defaultArena.minThreadCount.load(), defaultArena.maxThreadCount.load());
+
+	ArenaID arenaId = getArenaCount();
+	m_arenas[arenaId] = std::make_unique<Arena>(name, reservedThreadCount, reservedThreadCount, canLendWorkers, m_threadCount, &m_metrics, &m_inFlightGroups);
+	++m_arenaCount;
+
+	auto& arena = *m_arenas[arenaId];
+	while (arena.activeThreadCount < reservedThreadCount)
 	{
+		if (hasFreeSlot())
+		{
+			spawnWorker(arenaId);
+			continue;
+		}
+
+		// surplus default workers retire when they wake up and release their slots
+		lock.unlock();
+		defaultArena.semaphore.notifyAll();
 		std::this_thread::yield();
+		lock.lock();
+	}
+
+	return arenaId;
+}
+
+TaskExecuter::ArenaID TaskExecuter::findArena(const std::string& name) const
+{
+	for (std::uint16_t index = 0; index < getArenaCount(); ++index)
+	{
+		if (m_arenas[index]->name == name)
+		{
+			return index;
+		}
+	}
+
+	return INVALID_ARENA;
+}
+
+void TaskExecuter::setSchedulingPolicy(SchedulingPolicy policy) noexcept
+{
+	m_policy = policy;
+}
+
+void TaskExecuter::resize(std::uint16_t minThreadCount, std::uint16_t maxThreadCount)
+{
+	std::lock_guard guard(m_workersMutex);
+
+	std::uint16_t reservedThreadCount = 0;
+	for (std::uint16_t index = 1; index < getArenaCount(); ++index)
+	{
+		reservedThreadCount += m_arenas[index]->maxThreadCount;
+	}
+	assert(minThreadCount <= maxThreadCount && maxThreadCount + reservedThreadCount <= m_threadCount);
+
+	auto& arena = *m_arenas[DEFAULT_ARENA];
+	arena.minThreadCount = minThreadCount;
+	arena.maxThreadCount = maxThreadCount;
+
+	while (arena.activeThreadCount < arena.minThreadCount && hasFreeSlot())
+	{
+		spawnWorker(DEFAULT_ARENA);
+	}
+
+	// surplus workers notice the new limit when they wake up
+	arena.semaphore.notifyAll();
+}
+
+std::uint16_t TaskExecuter::getThreadCount() const noexcept
+{
+	return m_threadCount;
+}
+
+std::uint16_t TaskExecuter::getSlotCount() const noexcept
+{
+	return m_threadCount + Detail::MAX_HELPER_COUNT;
+}
+
+std::uint16_t TaskExecuter::getActiveThreadCount() const noexcept
+{
+	std::uint16_t result = 0;
+	for (std::uint16_t index = 0; index < getArenaCount(); ++index)
+	{
+		result += m_arenas[index]->activeThreadCount;
 	}
+	return result;
 }
 
-void TaskExecuter::work()
+std::uint16_t TaskExecuter::getCurrentWorkerIndex() const noexcept
 {
+	return t_executor == this ? t_workerIndex : INVALID_WORKER_INDEX;
+}
+
+MetricsSnapshot TaskExecuter::getMetrics() const
+{
+	return m_metrics.getSnapshot();
+}
+
+SchedulerMetrics& TaskExecuter::getMetricsRecorder() noexcept
+{
+	return m_metrics;
+}
+
+void TaskExecuter::work(std::uint16_t workerIndex, ArenaID arenaId, std::uint16_t affinityIndex)
+{
+	t_executor = this;
+	t_workerIndex = workerIndex;
+
+	auto& arena = *m_arenas[arenaId];
 	while (m_isEnabled)
 	{
-		this->m_semaphore.wait();
+		++arena.idleThreadCount;
+		const auto parkedSince = getTimestamp();
+		bool isSignaled = arena.semaphore.waitFor(m_idleTimeout);
+		m_metrics.recordParked(workerIndex, getTimestamp() - parkedSince);
+		--arena.idleThreadCount;
+
+		if ((!isSignaled || arena.activeThreadCount > arena.maxThreadCount) && tryRetireWorker(workerIndex, arenaId, affinityIndex, !isSignaled))
+		{
+			return;
+		}
+
+		if (!m_isEnabled)
+		{
+			break;
+		}
 
-		if (m_isEnabled && m_highPriorityQueue.execute())
+		bool hasSkippedTask = false;
+		if (arena.queue.execute(workerIndex, affinityIndex, arena.maxThreadCount, &hasSkippedTask))
+		{
+			arena.semaphore.notifyAll();
+			trySpawnWorker(arenaId);
+		}
+		else if (hasSkippedTask)
 		{
-			m_semaphore.notifyAll();
+			// this worker may have taken the wake-up meant for the preferred worker of the task;
+			// keep the arena awake until that worker takes it or the skips allow stealing it
+			std::this_thread::yield();
+			arena.semaphore.notifyAll();
+		}
+		else if (arena.canLendWorkers && lendWorker(arenaId))
+		{
+			// look for more work right away instead of sleeping until the timeout
+			arena.semaphore.notify();
 		}
 	}
 }
 
 void TaskExecuter::initializeWorkers()
 {
-	for (std::uint16_t index = 0; index < m_threadCount; ++index)
+	std::lock_guard guard(m_workersMutex);
+	auto& arena = *m_arenas[DEFAULT_ARENA];
+	while (arena.activeThreadCount < arena.minThreadCount)
+	{
+		spawnWorker(DEFAULT_ARENA);
+	}
+}
+
+bool TaskExecuter::lendWorker(ArenaID arenaId)
+{
+	for (std::uint16_t index = 0; index < getArenaCount(); ++index)
+	{
+		// a lent worker has no position in the other arena and only steals tasks with an affinity
+		auto& arena = *m_arenas[index];
+		if (index != arenaId && arena.queue.execute(t_workerIndex, INVALID_WORKER_INDEX, arena.maxThreadCount))
+		{
+			arena.semaphore.notifyAll();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TaskExecuter::wakeLenders(ArenaID arenaId)
+{
+	for (std::uint16_t index = 0; index < getArenaCount(); ++index)
+	{
+		auto& arena = *m_arenas[index];
+		if (index != arenaId && arena.canLendWorkers && arena.idleThreadCount != 0)
+		{
+			arena.semaphore.notify();
+		}
+	}
+}
+
+void TaskExecuter::trySpawnWorker(ArenaID arenaId)
+{
+	auto& arena = *m_arenas[arenaId];
+
+	// ready work is backed up only if nobody is waiting for it
+	if (arena.idleThreadCount != 0 || arena.activeThreadCount >= arena.maxThreadCount || !m_isEnabled)
+	{
+		return;
+	}
+
+	if (arena.queue.getSize() == 0)
+	{
+		return;
+	}
+
+	std::lock_guard guard(m_workersMutex);
+	if (arena.activeThreadCount < arena.maxThreadCount && m_isEnabled && hasFreeSlot())
+	{
+		spawnWorker(arenaId);
+	}
+}
+
+void TaskExecuter::spawnWorker(ArenaID arenaId)
+{
+	auto slot = std::find(m_isWorkerActive.begin(), m_isWorkerActive.end(), false);
+	assert(slot != m_isWorkerActive.end());
+
+	auto index = static_cast<std::uint16_t>(std::distance(m_isWorkerActive.begin(), slot));
+	auto& worker = m_workers[index];
+	if (worker.joinable())
 	{
-		m_workers.emplace_back([this]() {this->work(); });
+		// the thread which used this slot before has already retired
+		worker.join();
 	}
+
+	// the lowest free position, so the workers of an arena keep the positions 0..activeThreadCount
+	auto& arena = *m_arenas[arenaId];
+	auto affinitySlot = std::find(arena.isAffinitySlotTaken.begin(), arena.isAffinitySlotTaken.end(), false);
+	assert(affinitySlot != arena.isAffinitySlotTaken.end());
+	auto affinityIndex = static_cast<std::uint16_t>(std::distance(arena.isAffinitySlotTaken.begin(), affinitySlot));
+
+	*slot = true;
+	*affinitySlot = true;
+	++arena.activeThreadCount;
+	worker = std::thread([this, index, arenaId, affinityIndex]() {this->work(index, arenaId, affinityIndex); });
+}
+
+bool TaskExecuter::hasFreeSlot() const
+{
+	return std::find(m_isWorkerActive.begin(), m_isWorkerActive.end(), false) != m_isWorkerActive.end();
+}
+
+bool TaskExecuter::tryRetireWorker(std::uint16_t workerIndex, ArenaID arenaId, std::uint16_t affinityIndex, bool isIdle)
+{
+	std::lock_guard guard(m_workersMutex);
+	auto& arena = *m_arenas[arenaId];
+
+	const bool isSurplus = arena.activeThreadCount > arena.maxThreadCount;
+	const bool isIdleSurplus = isIdle && arena.activeThreadCount > arena.minThreadCount;
+	if (!m_isEnabled || (!isSurplus && !isIdleSurplus))
+	{
+		return false;
+	}
+
+	m_isWorkerActive[workerIndex] = false;
+	arena.isAffinitySlotTaken[affinityIndex] = false;
+	--arena.activeThreadCount;
+	return true;
+}
+
+std::uint16_t TaskExecuter::getArenaCount() const noexcept
+{
+	return m_arenaCount.load(std::memory_order_acquire);
 }
@@ -5,28 +5,148 @@
 #include <mutex>
 #include <condition_variable>
 #include <algorithm>
+#include <limits>
+#include <chrono>
+#include <array>
+#include <memory>
+#include <string>
 
+#include "config.hpp"
+#include "metrics.hpp"
 #include "task_group_queue.hpp"
 #include "utils/semaphore.hpp"
 
+// Workers are partitioned into arenas. Every arena has its own ready queue and its own
+// workers, and a group pushed to an arena is executed only by the workers of that arena
+// or by idle workers which other arenas lend out.
+// The default arena keeps between minThreadCount and maxThreadCount workers running.
+// A worker is added when work is pushed or finished while no worker of the arena is idle
+// and its queue is not empty, and a worker idle for longer than idleTimeout exits while there
+// are more than minThreadCount of them. maxThreadCount of the constructor is the number of
+// worker slots shared by all arenas, so worker indices are always below getThreadCount().
+// Threads helping out in push take the Detail::MAX_HELPER_COUNT slots after them.
 class TaskExecuter
 {
+public:
+	using ArenaID = std::uint16_t;
+
+	static constexpr std::uint16_t INVALID_WORKER_INDEX = std::numeric_limits<std::uint16_t>::max();
+	static constexpr ArenaID DEFAULT_ARENA = 0;
+	static constexpr ArenaID INVALID_ARENA = std::numeric_limits<ArenaID>::max();
+
 public:
 	TaskExecuter(std::uint16_t threadCount);
+	TaskExecuter(std::uint16_t minThreadCount, std::uint16_t maxThreadCount, std::chrono::milliseconds idleTimeout = Detail::WORKER_IDLE_TIMEOUT);
 	~TaskExecuter();
-	void push(TaskGroup& group);
+
+	// a group is queued only once, so a later Task::wait does not move it to another arena.
+	// While setMaxInFlightGroups groups are pushed and not finished, push blocks and the caller
+	// helps to run tasks of the same arena meanwhile, as long as a helper slot is free; tryPush
+	// and pushFor only wait and return false when no slot frees up in time.
+	void push(TaskGroup& group, ArenaID arena = DEFAULT_ARENA);
+	bool tryPush(TaskGroup& group, ArenaID arena = DEFAULT_ARENA);
+	bool pushFor(TaskGroup& group, std::chrono::nanoseconds timeout, ArenaID arena = DEFAULT_ARENA);
 	void wait();
 
+	// limits the number of groups pushed and not finished yet over all arenas, 0 means no limit
+	void setMaxInFlightGroups(std::uint32_t maxInFlightGroups) noexcept;
+	std::uint32_t getInFlightGroupCount() const noexcept;
+
+	// wakes the workers of every arena, e.g. after a task finished outside of the executor
+	void wakeWorkers();
+	// wakes one worker of the arena, e.g. when a task of a group already pushed there became ready
+	void wakeWorker(ArenaID arenaId);
+
+	// reserves reservedThreadCount worker slots taken from the default arena;
+	// blocks until enough default workers have retired to free the slots
+	ArenaID createArena(const std::string& name, std::uint16_t reservedThreadCount, bool canLendWorkers = true);
+	ArenaID findArena(const std::string& name) const;
+
+	// applies to groups pushed afterwards
+	void setSchedulingPolicy(SchedulingPolicy policy) noexcept;
+
+	// changes the limits of the default arena at runtime
+	void resize(std::uint16_t minThreadCount, std::uint16_t maxThreadCount);
+
+	// number of worker slots
+	std::uint16_t getThreadCount() const noexcept;
+	// number of worker and helper slots, e.g. for state kept per thread running tasks
+	std::uint16_t getSlotCount() const noexcept;
+	std::uint16_t getActiveThreadCount() const noexcept;
+
+	// index of the worker the calling thread belongs to, stable for the worker's lifetime, or of the
+	// helper slot while the thread helps out in push; INVALID_WORKER_INDEX for any other thread
+	std::uint16_t getCurrentWorkerIndex() const noexcept;
+
+	// counters per worker slot and latency histograms, cheap enough to be always on
+	MetricsSnapshot getMetrics() const;
+	SchedulerMetrics& getMetricsRecorder() noexcept;
+
 private:
-	void work();
+	struct Arena
+	{
+		Arena(const std::string& arenaName, std::uint16_t minThreadCount, std::uint16_t maxThreadCount, bool canLend, std::uint16_t slotCount, SchedulerMetrics* metrics, std::atomic<std::uint32_t>* inFlightGroups) :
+			name(arenaName),
+			queue(metrics, inFlightGroups),
+			semaphore(slotCount),
+			isAffinitySlotTaken(slotCount, false),
+			minThreadCount(minThreadCount),
+			maxThreadCount(maxThreadCount),
+			canLendWorkers(canLend)
+		{}
+
+		const std::string name;
+		TaskGroupQueue queue;
+		Semaphore semaphore;
+
+		// affinity keys map onto positions among the arena's maxThreadCount workers, not onto
+		// worker slots; taken positions are guarded by m_workersMutex
+		std::vector<bool> isAffinitySlotTaken;
+
+		std::atomic<std::uint16_t> minThreadCount;
+		std::atomic<std::uint16_t> maxThreadCount;
+		std::atomic<std::uint16_t> activeThreadCount = 0;
+		std::atomic<std::uint16_t> idleThreadCount = 0;
+		const bool canLendWorkers;
+	};
+
+	// false if the group has already been pushed
+	bool pushAdmitted(TaskGroup& group, ArenaID arenaId);
+	// reserves one of the m_maxInFlightGroups slots, released by the queue when the group has finished
+	bool tryAdmit();
+	// runs a task of the arena in a free helper slot, false if there is none or no task is ready
+	bool helpExecute(ArenaID arenaId);
+
+	void work(std::uint16_t workerIndex, ArenaID arenaId, std::uint16_t affinityIndex);
 	void initializeWorkers();
 
+	bool lendWorker(ArenaID arenaId);
+	void wakeLenders(ArenaID arenaId);
+
+	void trySpawnWorker(ArenaID arenaId);
+	void spawnWorker(ArenaID arenaId);
+	bool hasFreeSlot() const;
+	bool tryRetireWorker(std::uint16_t workerIndex, ArenaID arenaId, std::uint16_t affinityIndex, bool isIdle);
+
+	std::uint16_t getArenaCount() const noexcept;
+
 private:
 	std::vector<std::thread> m_workers;
-	TaskGroupQueue m_highPriorityQueue;
+	std::vector<bool> m_isWorkerActive;
+	mutable std::mutex m_workersMutex;
+
+	std::array<std::unique_ptr<Arena>, Detail::MAX_ARENA_COUNT> m_arenas;
+	std::atomic<std::uint16_t> m_arenaCount = 0;
 
 	const std::uint16_t m_threadCount;
+	const std::chrono::milliseconds m_idleTimeout;
+
+	SchedulerMetrics m_metrics;
+	std::atomic<SchedulingPolicy> m_policy = SchedulingPolicy::CriticalPath;
+
+	std::atomic<std::uint32_t> m_maxInFlightGroups = 0;
+	std::atomic<std::uint32_t> m_inFlightGroups = 0;
+	std::array<std::atomic<bool>, Detail::MAX_HELPER_COUNT> m_isHelperSlotTaken = {};
 
-	Semaphore m_semaphore;
-	volatile bool m_isEnabled;
+	std::atomic<bool> m_isEnabled;
 };
@@ -2,25 +2,125 @@
 #include "config.hpp"
 #include "context.hpp"
 #include "task.hpp"
+#include "graph_capture.hpp"
 
+// Every task created here starts a task group, and at most SchedulerConfig::maxTaskGroupCount groups
+// are alive at once. A group stays alive while a Task of it is held and until it has finished, so
+// createTask blocks once the limit is reached, for good if the calling thread holds the groups
+// itself, e.g. unsubmitted tasks; inside a task it fails instead of blocking. tryCreateTask and
+// tryCreateTaskGroup return an empty Task or nullptr instead.
 class TaskFactory
 {
 public:
-	
+	// the first factory maps the slab region of the config, later ones share it
+	explicit TaskFactory(const SchedulerConfig& config = {}) :
+		m_taskGroupPool(config.maxTaskGroupCount)
+	{
+		Detail::SlabAllocator::getInstance().initialize(config);
+	}
+
+
 	template<typename Callable, typename ... Args>
 	[[nodiscard]]
 	auto createTask(Callable&& callable, Args&&... args)
 	{
-		//TODO: handle auto deleter in case of FUBAR
-		auto taskGroupHandle = m_taskGroupPool.createTaskGroup();
-		auto& tg = m_taskGroupPool.get(taskGroupHandle);
+		auto* taskNode = createTaskNode(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		return Task<std::invoke_result_t<Callable, Args...>>(taskNode);
+	}
 
-		auto nodeId = tg.addNode(std::forward<Callable>(callable), std::forward<Args>(args)...);
-		auto* taskNode = tg.getTaskNode(nodeId);
+	// the task prefers the worker chosen by the affinity key
+	template<typename Callable, typename ... Args>
+	[[nodiscard]]
+	auto createTask(Affinity affinity, Callable&& callable, Args&&... args)
+	{
+		auto* taskNode = createTaskNode(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		taskNode->setAffinity(affinity.key);
+		return Task<std::invoke_result_t<Callable, Args...>>(taskNode);
+	}
 
+	// the task runs on the thread owning the mailbox when it pumps
+	template<typename Callable, typename ... Args>
+	[[nodiscard]]
+	auto createTask(OnThread thread, Callable&& callable, Args&&... args)
+	{
+		assert(thread.mailbox);
+		auto* taskNode = createTaskNode(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		taskNode->setMailbox(thread.mailbox);
 		return Task<std::invoke_result_t<Callable, Args...>>(taskNode);
 	}
 
+	// an empty Task when maxTaskGroupCount groups are alive
+	template<typename Callable, typename ... Args>
+	[[nodiscard]]
+	auto tryCreateTask(Callable&& callable, Args&&... args)
+	{
+		using TaskType = Task<std::invoke_result_t<Callable, Args...>>;
+
+		auto* tg = tryCreateTaskGroup();
+		if (!tg)
+		{
+			return TaskType();
+		}
+
+		auto nodeId = tg->addNode(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		return TaskType(tg->getTaskNode(nodeId));
+	}
+
+	// an empty group for graphs which do not fit createTask/then, e.g. several roots;
+	// its nodes are built with TaskGroup::addNode and TaskGroup::link
+	TaskGroup& createTaskGroup()
+	{
+		auto& tg = m_taskGroupPool.get(m_taskGroupPool.createTaskGroup());
+		tg.setRecorder(m_recorder);
+		return tg;
+	}
+
+	// nullptr when maxTaskGroupCount groups are alive
+	TaskGroup* tryCreateTaskGroup()
+	{
+		auto handle = m_taskGroupPool.tryCreateTaskGroup();
+		if (!handle)
+		{
+			return nullptr;
+		}
+
+		auto& tg = m_taskGroupPool.get(*handle);
+		tg.setRecorder(m_recorder);
+		return &tg;
+	}
+
+	// a group which runs while it is being built, see StreamingGraph; it is never recorded
+	TaskGroup& createStreamingGroup()
+	{
+		auto& tg = m_taskGroupPool.get(m_taskGroupPool.createTaskGroup());
+		tg.enableStreaming();
+		return tg;
+	}
+
+	// every group created afterwards is written to the recorder when it finishes
+	void setGraphRecorder(GraphRecorder* recorder)
+	{
+		m_recorder = recorder;
+	}
+
+	// destroys the finished task groups retired since the last collection
+	void collectFinishedTasks()
+	{
+		m_taskGroupPool.collect();
+	}
+
+private:
+	template<typename Callable, typename ... Args>
+	TaskGroup::NodeType* createTaskNode(Callable&& callable, Args&&... args)
+	{
+		//TODO: handle auto deleter in case of FUBAR
+		auto& tg = createTaskGroup();
+
+		auto nodeId = tg.addNode(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		return tg.getTaskNode(nodeId);
+	}
+
 private:
-	TaskGroupPool m_taskGroupPool = {};
+	TaskGroupPool m_taskGroupPool;
+	GraphRecorder* m_recorder = nullptr;
 };
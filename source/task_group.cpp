@@ -1,11 +1,255 @@
 #include "task_group.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include "graph_capture.hpp"
+#include "utils/time_utils.hpp"
+
+namespace
+{
+	thread_local std::uint32_t t_runningTaskDepth = 0;
+}
+
+TaskGroup::~TaskGroup()
+{
+	if (!m_stream)
+	{
+		return;
+	}
+
+	// sections which have not been collected yet, including those of a group which never finished
+	const size_t sectionCount = m_stream->sections.size();
+	for (size_t index = 0; index < sectionCount; ++index)
+	{
+		if (auto* section = m_stream->sections[index].load(std::memory_order_acquire))
+		{
+			freeStreamSection(section);
+		}
+	}
+}
+
 void TaskGroup::link(size_t from, size_t to)
 {
-	auto& fromNode = m_nodes[from];
-	fromNode.addAdjancedNode(to);
-	auto& toNode = m_nodes[to];
-	toNode.addParent(from);
+	assert(!isSubmitted());
+
+	auto& adjanced = m_edges.construct(m_edges.allocate(), to);
+	m_nodes[from].addAdjancedNode(adjanced);
+
+	auto& parent = m_edges.construct(m_edges.allocate(), from);
+	m_nodes[to].addParent(parent);
+}
+
+TaskGroup& TaskGroup::createFollowUpGroup()
+{
+	auto& group = m_pool.get(m_pool.createTaskGroup());
+	group.setRecorder(m_recorder);
+	return group;
+}
+
+void TaskGroup::addFollowUp(NodeType& node, NodeType& followUp)
+{
+	// the group of the follow-up stays alive until the node has released it
+	followUp.addUnfinishedParent();
+	followUp.getGroup().increaseReferenceCount();
+	if (!node.tryAddFollowUp(followUp))
+	{
+		followUp.onParentTaskFinished();
+		followUp.getGroup().decreaseReferenceCount();
+	}
+}
+
+void TaskGroup::releaseFollowUps(NodeType& node)
+{
+	auto* followUp = node.closeFollowUps();
+	while (followUp)
+	{
+		// the follow-up may run and finish as soon as it is released
+		auto* next = followUp->getNextFollowUp();
+		auto& group = followUp->getGroup();
+		followUp->onParentTaskFinished();
+		group.decreaseReferenceCount();
+		followUp = next;
+	}
+}
+
+void TaskGroup::enableStreaming()
+{
+	assert(!m_stream && m_nodes.size() == 0 && !isSubmitted());
+	m_stream = std::make_unique<StreamState>();
+
+	// held until closeStream, so the group does not finish while it is still being built
+	++m_unfinishedJobNumbers;
+}
+
+bool TaskGroup::isStreaming() const
+{
+	return m_stream != nullptr;
+}
+
+bool TaskGroup::linkStreamingNode(NodeType& node, const size_t* parents, size_t parentCount)
+{
+	// the node cannot become available before all of its parents are linked
+	node.addUnfinishedParent();
+
+	for (size_t index = 0; index < parentCount; ++index)
+	{
+		assert(parents[index] < node.getID());
+
+		// a parent whose section has been released has finished
+		auto* parent = findStreamingNode(parents[index]);
+		if (!parent)
+		{
+			continue;
+		}
+
+		node.addUnfinishedParent();
+		auto* edge = new (Detail::slabAllocate(sizeof(NodeType::EdgeType), alignof(NodeType::EdgeType))) NodeType::EdgeType{ node.getID() };
+		if (!parent->tryAddAdjancedNode(*edge))
+		{
+			// the parent has finished in the meantime
+			Detail::slabDeallocate(edge, sizeof(NodeType::EdgeType), alignof(NodeType::EdgeType));
+			node.onParentTaskFinished();
+		}
+	}
+
+	if (node.onParentTaskFinished())
+	{
+		pushReadyTask(node);
+		return true;
+	}
+
+	return false;
+}
+
+void TaskGroup::closeStream()
+{
+	auto& stream = *m_stream;
+	assert(!stream.isClosed);
+	stream.isClosed = true;
+
+	const auto usedSlots = static_cast<std::uint32_t>(stream.nodeCount & (Detail::STREAM_SECTION_SIZE - 1));
+	if (usedSlots != 0)
+	{
+		auto* section = stream.sections[stream.sections.size() - 1].load(std::memory_order_relaxed);
+		finishStreamSlots(*section, Detail::STREAM_SECTION_SIZE - usedSlots);
+	}
+
+	onJobFinished();
+}
+
+void TaskGroup::waitStream()
+{
+	assert(m_stream->isClosed);
+	m_stream->finishedEvent.wait();
+	collectStreamSections();
+}
+
+void TaskGroup::collectStreamSections()
+{
+	auto* section = m_stream->retired.exchange(nullptr, std::memory_order_acquire);
+	while (section)
+	{
+		auto* next = section->nextRetired;
+		m_stream->sections[section->index].store(nullptr, std::memory_order_relaxed);
+		freeStreamSection(section);
+		section = next;
+	}
+}
+
+size_t TaskGroup::allocateStreamingNode()
+{
+	auto& stream = *m_stream;
+	assert(!stream.isClosed);
+
+	const size_t nodeId = stream.nodeCount++;
+	if ((nodeId & (Detail::STREAM_SECTION_SIZE - 1)) == 0)
+	{
+		// only the thread adding nodes frees sections, so it does so whenever it opens a new one
+		collectStreamSections();
+
+		auto* section = new (Detail::slabAllocate(sizeof(StreamSection), alignof(StreamSection))) StreamSection();
+		section->index = nodeId >> Detail::STREAM_SECTION_SIZE_LOG2;
+		section->nodes = static_cast<StreamSection::StorageType*>(Detail::slabAllocate(sizeof(StreamSection::StorageType) * Detail::STREAM_SECTION_SIZE, alignof(StreamSection::StorageType)));
+
+		const size_t sectionIndex = stream.sections.allocate();
+		assert(sectionIndex == section->index);
+		stream.sections.construct(sectionIndex, section);
+	}
+
+	++stream.sections[nodeId >> Detail::STREAM_SECTION_SIZE_LOG2].load(std::memory_order_relaxed)->nodeCount;
+	++m_unfinishedJobNumbers;
+	return nodeId;
+}
+
+void* TaskGroup::getStreamingSlot(size_t nodeId)
+{
+	auto* section = m_stream->sections[nodeId >> Detail::STREAM_SECTION_SIZE_LOG2].load(std::memory_order_acquire);
+	assert(section);
+	return &section->nodes[nodeId & (Detail::STREAM_SECTION_SIZE - 1)];
+}
+
+TaskGroup::NodeType* TaskGroup::findStreamingNode(size_t nodeId)
+{
+	auto* section = m_stream->sections[nodeId >> Detail::STREAM_SECTION_SIZE_LOG2].load(std::memory_order_acquire);
+	if (!section)
+	{
+		return nullptr;
+	}
+
+	return std::launder(reinterpret_cast<NodeType*>(&section->nodes[nodeId & (Detail::STREAM_SECTION_SIZE - 1)]));
+}
+
+void TaskGroup::pushReadyTask(NodeType& node)
+{
+	std::lock_guard guard(m_stream->readyMutex);
+	m_stream->readyTasks.push_back(&node);
+}
+
+void TaskGroup::finishStreamSlots(StreamSection& section, std::uint32_t count)
+{
+	if (section.unfinishedCount.fetch_sub(count, std::memory_order_acq_rel) != count)
+	{
+		return;
+	}
+
+	// freed by collectStreamSections on the thread adding the nodes
+	auto& retired = m_stream->retired;
+	auto* head = retired.load(std::memory_order_relaxed);
+	do
+	{
+		section.nextRetired = head;
+	} while (!retired.compare_exchange_weak(head, &section, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void TaskGroup::freeStreamSection(StreamSection* section)
+{
+	for (std::uint32_t index = 0; index < section->nodeCount; ++index)
+	{
+		auto& node = *std::launder(reinterpret_cast<NodeType*>(&section->nodes[index]));
+
+		// only a node which has not finished still owns its edges
+		auto* edge = node.closeAdjancedNodes();
+		while (edge)
+		{
+			auto* next = edge->next;
+			Detail::slabDeallocate(edge, sizeof(NodeType::EdgeType), alignof(NodeType::EdgeType));
+			edge = next;
+		}
+
+		node.~NodeType();
+	}
+
+	Detail::slabDeallocate(section->nodes, sizeof(StreamSection::StorageType) * Detail::STREAM_SECTION_SIZE, alignof(StreamSection::StorageType));
+	section->~StreamSection();
+	Detail::slabDeallocate(section, sizeof(StreamSection), alignof(StreamSection));
+}
+
+void TaskGroup::reserve(size_t nodeCount, size_t edgeCount)
+{
+	m_nodes.reserve(nodeCount);
+	m_edges.reserve(edgeCount * 2);
 }
 
 TaskGroup::NodeType* TaskGroup::getTaskNode(size_t nodeId)
@@ -14,8 +258,18 @@ TaskGroup::NodeType* TaskGroup::getTaskNode(size_t nodeId)
 	return &m_nodes[nodeId];
 }
 
-TaskGroup::NodeType* TaskGroup::getAvailableTask()
+size_t TaskGroup::getNodeCount() const
+{
+	return m_nodes.size();
+}
+
+TaskGroup::NodeType* TaskGroup::getAvailableTask(std::uint16_t affinityIndex, std::uint16_t affinityCount, WorkerMetrics* metrics, bool* hasSkippedTask)
 {
+	if (m_stream)
+	{
+		return getAvailableStreamingTask(affinityIndex, affinityCount, metrics, hasSkippedTask);
+	}
+
 	if (m_currentRound >= m_topological.size())
 	{
 		return nullptr;
@@ -36,10 +290,18 @@ TaskGroup::NodeType* TaskGroup::getAvailableTask()
 	{
 		if (round.taskRound[index]->isAvailable())
 		{
-			auto copy = round.taskRound[round.currentTask];
-			round.taskRound[round.currentTask] = round.taskRound[index];
-			round.taskRound[index] = copy;
-			return round.taskRound[round.currentTask++];
+			if (canTake(*round.taskRound[index], affinityIndex, affinityCount, metrics))
+			{
+				// rotate instead of swap to keep the rest of the round in priority order
+				auto begin = round.taskRound.begin();
+				std::rotate(begin + round.currentTask, begin + index, begin + index + 1);
+				return round.taskRound[round.currentTask++];
+			}
+
+			if (hasSkippedTask)
+			{
+				*hasSkippedTask = true;
+			}
 		}
 		++index;
 	}
@@ -47,21 +309,157 @@ TaskGroup::NodeType* TaskGroup::getAvailableTask()
 	return nullptr;
 }
 
+TaskGroup::NodeType* TaskGroup::getAvailableStreamingTask(std::uint16_t affinityIndex, std::uint16_t affinityCount, WorkerMetrics* metrics, bool* hasSkippedTask)
+{
+	std::lock_guard guard(m_stream->readyMutex);
+
+	auto& readyTasks = m_stream->readyTasks;
+	for (auto task = readyTasks.begin(); task != readyTasks.end(); ++task)
+	{
+		if (canTake(**task, affinityIndex, affinityCount, metrics))
+		{
+			auto* node = *task;
+			readyTasks.erase(task);
+			return node;
+		}
+
+		if (hasSkippedTask)
+		{
+			*hasSkippedTask = true;
+		}
+	}
+
+	return nullptr;
+}
+
+bool TaskGroup::canTake(NodeType& node, std::uint16_t affinityIndex, std::uint16_t affinityCount, WorkerMetrics* metrics)
+{
+	const auto affinity = node.getAffinity();
+	if (affinity == Affinity::NONE || affinity % affinityCount == affinityIndex)
+	{
+		return true;
+	}
+
+	// the preferred worker is busy or gone, let somebody else steal the task
+	const bool isStolen = node.skipByOtherWorker() > Detail::AFFINITY_STEAL_THRESHOLD;
+	if (metrics)
+	{
+		metrics->stealsAttempted.fetch_add(1, std::memory_order_relaxed);
+		if (isStolen)
+		{
+			metrics->stealsSucceeded.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	return isStolen;
+}
+
+void TaskGroup::runTask(NodeType& node, SchedulerMetrics* metrics, std::uint16_t workerIndex)
+{
+	auto& ctx = node.getValue();
+
+	const auto startTime = getTimestamp();
+	++t_runningTaskDepth;
+	ctx.job(ctx.data, ctx.returnedValue);
+	const auto finishTime = getTimestamp();
+	const auto executionTime = finishTime - startTime;
+
+	node.setRunTimes(startTime, finishTime);
+	Detail::updateCostEstimate(ctx.costEstimate, executionTime);
+	if (metrics)
+	{
+		const auto readyTime = node.getReadyTime();
+		metrics->recordTask(workerIndex, readyTime && readyTime < startTime ? startTime - readyTime : 0, executionTime);
+	}
+
+	// continuations run from hasComplited count as part of the task
+	hasComplited(node);
+	--t_runningTaskDepth;
+}
+
+bool TaskGroup::isInsideTask() noexcept
+{
+	return t_runningTaskDepth != 0;
+}
+
 void TaskGroup::hasComplited(NodeType& node)
 {
-	for (const auto& index : node.getAdjancedNodes())
+	if (m_stream)
+	{
+		hasComplitedStreaming(node);
+		return;
+	}
+
+	node.forEachAdjancedNode([this](size_t index)
 	{
 		m_nodes[index].onParentTaskFinished();
+	});
+
+	node.fireOnFinishedEvent();
+	releaseFollowUps(node);
+	onJobFinished();
+}
+
+void TaskGroup::hasComplitedStreaming(NodeType& node)
+{
+	// edges are read before the child is released, the child may run and be freed right after
+	auto* edge = node.closeAdjancedNodes();
+	while (edge)
+	{
+		auto* next = edge->next;
+		auto* child = findStreamingNode(edge->node);
+		Detail::slabDeallocate(edge, sizeof(NodeType::EdgeType), alignof(NodeType::EdgeType));
+
+		if (child->onParentTaskFinished())
+		{
+			pushReadyTask(*child);
+		}
+		edge = next;
 	}
 
+	auto& section = *m_stream->sections[node.getID() >> Detail::STREAM_SECTION_SIZE_LOG2].load(std::memory_order_acquire);
 	node.fireOnFinishedEvent();
+	releaseFollowUps(node);
+
+	// the node may be freed from here on
+	finishStreamSlots(section, 1);
+	onJobFinished();
+}
 
+void TaskGroup::onJobFinished()
+{
 	if (--m_unfinishedJobNumbers == 0)
 	{
+		if (m_recorder)
+		{
+			m_recorder->record(*this);
+		}
+
+		if (m_stream)
+		{
+			m_stream->finishedEvent.notify();
+		}
+
 		decreaseReferenceCount();
 	}
 }
 
+GroupProfile TaskGroup::getProfile() const
+{
+	GroupProfile profile;
+	const size_t nodeCount = m_nodes.size();
+	for (size_t index = 0; index < nodeCount; ++index)
+	{
+		const auto& node = m_nodes[index];
+		if (node.isFinished())
+		{
+			profile.add(node.getProfile());
+		}
+	}
+
+	return profile;
+}
+
 bool TaskGroup::isFinished() const
 {
 	return m_unfinishedJobNumbers == 0;
@@ -72,35 +470,92 @@ bool TaskGroup::isLastTask() const
 	return m_unfinishedJobNumbers == 1;
 }
 
-void TaskGroup::topological()
+void TaskGroup::topological(SchedulingPolicy policy)
 {
 	std::vector<TopologicalRound> result;
 
-	std::vector<TopologicalNode> vertexes;
-	size_t idx = 0;
-	for (const auto& node : m_nodes)
+	const size_t nodeCount = m_nodes.size();
+	std::vector<size_t> parentCounts(nodeCount);
+	std::vector<size_t> orphans;
+	const auto readyTime = getTimestamp();
+	for (size_t idx = 0; idx < nodeCount; ++idx)
 	{
-		vertexes.emplace_back(idx, node.getParentsCount());
-		++idx;
+		parentCounts[idx] = m_nodes[idx].getParentsCount();
+		if (parentCounts[idx] == 0)
+		{
+			orphans.push_back(idx);
+			m_nodes[idx].setReadyTime(readyTime);
+		}
 	}
 
-	while (!vertexes.empty())
+	std::vector<size_t> nextOrphans;
+	while (!orphans.empty())
 	{
 		TopologicalRound round;
-		auto S = getOrphanNode(vertexes);
-		for (auto& e : S)
+		for (auto nodeId : orphans)
 		{
-			auto& node = m_nodes[e.nodeId];
-			const auto& adjances = node.getAdjancedNodes();
+			auto& node = m_nodes[nodeId];
 			round.taskRound.push_back(&node);
-			decreaseParentCount(vertexes, adjances);
+			node.forEachAdjancedNode([&parentCounts, &nextOrphans](size_t index)
+			{
+				if (--parentCounts[index] == 0)
+				{
+					nextOrphans.push_back(index);
+				}
+			});
 		}
 		round.currentTask = 0;
-		result.emplace_back(round);
+		result.emplace_back(std::move(round));
+
+		orphans.swap(nextOrphans);
+		nextOrphans.clear();
 	}
 
+	m_topological = std::move(result);
 
-	m_topological = result;
+	if (policy == SchedulingPolicy::CriticalPath)
+	{
+		computePriorities();
+	}
+}
+
+void TaskGroup::setRecorder(GraphRecorder* recorder)
+{
+	m_recorder = recorder;
+}
+
+void TaskGroup::computePriorities()
+{
+	// rounds go in topological order, so walking them backwards sees every child before its parents
+	for (auto round = m_topological.rbegin(); round != m_topological.rend(); ++round)
+	{
+		for (auto* node : round->taskRound)
+		{
+			std::uint64_t cost = node->getCost();
+			if (cost == 0)
+			{
+				auto* estimate = node->getValue().costEstimate;
+				cost = estimate ? estimate->load(std::memory_order_relaxed) : 0;
+			}
+			if (cost == 0)
+			{
+				cost = Detail::DEFAULT_TASK_COST;
+			}
+
+			std::uint64_t longestChild = 0;
+			node->forEachAdjancedNode([this, &longestChild](size_t index)
+			{
+				longestChild = std::max(longestChild, m_nodes[index].getPriority());
+			});
+
+			node->setPriority(cost + longestChild);
+		}
+
+		std::stable_sort(round->taskRound.begin(), round->taskRound.end(), [](const NodeType* lhs, const NodeType* rhs)
+		{
+			return lhs->getPriority() > rhs->getPriority();
+		});
+	}
 }
 
 Context& TaskGroup::get(size_t index)
@@ -111,10 +566,9 @@ Context& TaskGroup::get(size_t index)
 void TaskGroup::decreaseReferenceCount()
 {
 	assert(m_refCount);
-	--m_refCount;
 
-	//first approach: remove immediately 
-	if (m_refCount == 0)
+	// the group is only retired here, the destruction is deferred to TaskGroupPool::collect
+	if (--m_refCount == 0)
 	{
 		removeTaskGroup();
 	}
@@ -125,44 +579,91 @@ void TaskGroup::increaseReferenceCount()
 	++m_refCount;
 }
 
-std::vector<TaskGroup::TopologicalNode> TaskGroup::getOrphanNode(std::vector<TopologicalNode>& nodes)
+bool TaskGroup::isSubmitted() const
+{
+	return m_isSubmitted;
+}
+
+bool TaskGroup::markSubmitted()
+{
+	return !m_isSubmitted.exchange(true);
+}
+
+void TaskGroup::removeTaskGroup()
+{
+	m_pool.retireTaskGroup(*this);
+}
+
+TaskGroupPool::TaskGroupPool(std::uint32_t size) :
+	m_pool(size),
+	m_size(size)
 {
-	std::vector<TopologicalNode> result;
+}
 
-	auto iter = nodes.begin();
-	while (iter != nodes.end())
+TaskGroupPool::~TaskGroupPool()
+{
+	collect();
+}
+
+TaskGroupPool::TaskGroupID TaskGroupPool::createTaskGroup()
+{
+	// when every slot is taken, wait for the workers to finish a group instead of overflowing the pool
+	auto handle = tryCreateTaskGroup();
+	while (!handle)
 	{
-		if (iter->parentCount == 0)
-		{
-			result.push_back(*iter);
-			iter = nodes.erase(iter);
-		}
-		else
+		// a task waiting here holds its worker, and with the groups held by its own thread it never
+		// gets a slot; it has to use tryCreateTaskGroup, this fails in every build type
+		assert(!TaskGroup::isInsideTask() && "task group pool is full inside a task");
+		if (TaskGroup::isInsideTask())
 		{
-			++iter;
+			std::terminate();
 		}
+
+		std::this_thread::yield();
+		handle = tryCreateTaskGroup();
 	}
 
-	return result;
+	return *handle;
 }
 
-void TaskGroup::decreaseParentCount(std::vector<TopologicalNode>& vertexes, const std::vector<size_t>& adjances)
+std::optional<TaskGroupPool::TaskGroupID> TaskGroupPool::tryCreateTaskGroup()
 {
-	for (auto& vertex : vertexes)
+	if (m_retiredCount >= Detail::RECLAIM_BATCH_SIZE || m_liveCount >= m_size)
 	{
-		const auto& it = std::find_if(adjances.begin(), adjances.end(), [id = vertex.nodeId](const size_t& node)
-		{
-			return id == node;
-		});
+		collect();
+	}
 
-		if (it != adjances.end())
-		{
-			--vertex.parentCount;
-		}
+	auto handle = m_pool.tryEmplace(*this);
+	if (handle)
+	{
+		++m_liveCount;
 	}
+	return handle;
 }
 
-void TaskGroup::removeTaskGroup()
+void TaskGroupPool::retireTaskGroup(TaskGroup& group)
+{
+	auto* head = m_retired.load(std::memory_order_relaxed);
+	do
+	{
+		group.m_nextRetired = head;
+	} while (!m_retired.compare_exchange_weak(head, &group, std::memory_order_release, std::memory_order_relaxed));
+
+	++m_retiredCount;
+}
+
+void TaskGroupPool::collect()
 {
-	m_pool.removeTaskGroup(m_groupId);
+	auto* group = m_retired.exchange(nullptr, std::memory_order_acquire);
+	while (group)
+	{
+		auto* next = group->m_nextRetired;
+		auto handle = group->m_groupId;
+
+		m_pool.free(handle);
+		--m_retiredCount;
+		--m_liveCount;
+
+		group = next;
+	}
 }
\ No newline at end of file
@@ -1,18 +1,25 @@
 #pragma once
 #include <optional>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <iostream>
 #include <mutex>
 #include <cassert>
 #include <atomic>
 
 #include "private/handle_array.hpp"
+#include "private/chunked_array.hpp"
 #include "private/job_creator.hpp"
+#include "private/slab_allocator.hpp"
 
+#include "config.hpp"
 #include "context.hpp"
+#include "metrics.hpp"
 #include "task_node.hpp"
 
 class TaskGroupPool;
+class GraphRecorder;
 
 class TaskGroup
 {
@@ -29,35 +36,92 @@ public:
 	TaskGroup(std::uint16_t id, TaskGroupPool& pool) : m_groupId{id}, m_pool{ pool }
 	{}
 
-	~TaskGroup() = default;
+	~TaskGroup();
 
 	template<typename Callable, typename ... Args>
 	size_t addNode(Callable&& callable, Args&&... args)
 	{
 		using DataType = Detail::PacketTask<Callable, Args ...>;
 		auto job = Detail::JobCreator<DataType>::createJob();
-		auto data = std::make_shared<DataType>(std::forward<Callable>(callable), std::forward<Args>(args)...);
+		auto data = std::allocate_shared<DataType>(Detail::SlabStdAllocator<DataType>{}, std::forward<Callable>(callable), std::forward<Args>(args)...);
 
-		std::lock_guard guard(m_nodeMutex);
-		size_t idx = m_nodes.size();
-		m_nodes.emplace_back(*this, idx, std::move(job), std::move(data), std::any());
+		// a submitted group has been sorted already, a node added now would never run
+		assert(!isSubmitted());
+
+		size_t idx = m_nodes.allocate();
+		m_nodes.construct(idx, *this, idx, std::move(job), std::move(data), std::any(), Detail::JobCreator<DataType>::getCostEstimate());
 		++m_unfinishedJobNumbers;
 
 		return idx;
 	}
 
+	// addNode and link may be called from several threads while the group is being built,
+	// but not after it has been submitted
 	void link(size_t from, size_t to);
 
+	// an empty group from the same pool, e.g. for a continuation of a submitted group
+	TaskGroup& createFollowUpGroup();
+	// followUp, a node of another group, becomes available only once node has finished
+	static void addFollowUp(NodeType& node, NodeType& followUp);
+
+	// A streaming group (see StreamingGraph) is pushed to the executor before it is built and has
+	// no rounds: a node is queued as soon as it is linked and its parents have finished. Nodes are
+	// kept in sections of Detail::STREAM_SECTION_SIZE, and a section is released once all of its
+	// nodes have finished. Nodes are added by one thread only, which also releases the sections.
+	void enableStreaming();
+	bool isStreaming() const;
+
+	template<typename Callable, typename ... Args>
+	NodeType& addStreamingNode(Callable&& callable, Args&&... args)
+	{
+		using DataType = Detail::PacketTask<Callable, Args ...>;
+		auto job = Detail::JobCreator<DataType>::createJob();
+		auto data = std::allocate_shared<DataType>(Detail::SlabStdAllocator<DataType>{}, std::forward<Callable>(callable), std::forward<Args>(args)...);
+
+		const size_t idx = allocateStreamingNode();
+		return *new (getStreamingSlot(idx)) NodeType{ *this, idx, std::move(job), std::move(data), std::any(), Detail::JobCreator<DataType>::getCostEstimate() };
+	}
+
+	// links the node to the parents which have not finished yet; returns true if the node is ready right away
+	bool linkStreamingNode(NodeType& node, const size_t* parents, size_t parentCount);
+
+	// no more nodes are added, the group finishes with its last node
+	void closeStream();
+	// blocks until the stream is closed and all of its nodes have finished
+	void waitStream();
+	// frees the sections whose nodes have all finished
+	void collectStreamSections();
+
+	void reserve(size_t nodeCount, size_t edgeCount);
+
 	NodeType* getTaskNode(size_t nodeId);
-	NodeType* getAvailableTask();
+	size_t getNodeCount() const;
+
+	// a task with an affinity is taken by the worker whose affinityIndex is key % affinityCount, other
+	// workers take it only after passing over it Detail::AFFINITY_STEAL_THRESHOLD times;
+	// hasSkippedTask is set when a ready task was left for another worker
+	NodeType* getAvailableTask(std::uint16_t affinityIndex, std::uint16_t affinityCount, WorkerMetrics* metrics = nullptr, bool* hasSkippedTask = nullptr);
 
+	// executes the job of the node and marks it completed
+	void runTask(NodeType& node, SchedulerMetrics* metrics, std::uint16_t workerIndex);
+
+	// true while the calling thread runs the job of a task
+	static bool isInsideTask() noexcept;
 	void hasComplited(NodeType& node);
 
 	bool isFinished() const;
 
+	// statistics of the tasks finished so far, see Task::getProfile for a single task
+	GroupProfile getProfile() const;
+
 	bool isLastTask() const;
 
-	void topological();
+	// builds the rounds; with SchedulingPolicy::CriticalPath every round is ordered
+	// by the longest remaining path (bottom level)
+	void topological(SchedulingPolicy policy = SchedulingPolicy::CriticalPath);
+
+	// the group is written to the recorder when its last task has finished
+	void setRecorder(GraphRecorder* recorder);
 
 	[[nodiscard]]
 	Context& get(size_t index);
@@ -65,33 +129,68 @@ public:
 	void decreaseReferenceCount();
 	void increaseReferenceCount();
 
+	// returns false if the group has already been handed to an executor
+	bool markSubmitted();
+	bool isSubmitted() const;
+
 private:
+	friend class TaskGroupPool;
 
-	struct TopologicalNode
+	struct StreamSection
 	{
-		TopologicalNode(size_t id, size_t count) : nodeId(id), parentCount(count)
-		{}
-
-		size_t nodeId;
-		size_t parentCount = 0;
+		using StorageType = std::aligned_storage_t<sizeof(NodeType), alignof(NodeType)>;
+
+		// starts with every slot unfinished, the slots left empty by closeStream are subtracted
+		std::atomic<std::uint32_t> unfinishedCount = Detail::STREAM_SECTION_SIZE;
+		std::uint32_t nodeCount = 0;
+		size_t index = 0;
+		StorageType* nodes = nullptr;
+		StreamSection* nextRetired = nullptr;
 	};
 
-	std::vector<TopologicalNode> getOrphanNode(std::vector<TopologicalNode>& nodes);
+	struct StreamState
+	{
+		// released sections are reset to nullptr; a parent found there has finished
+		ChunkedArray<std::atomic<StreamSection*>> sections;
+		size_t nodeCount = 0;
+		bool isClosed = false;
+
+		std::mutex readyMutex;
+		std::deque<NodeType*> readyTasks;
 
-	void decreaseParentCount(std::vector<TopologicalNode>& vertexes, const std::vector<size_t>& adjances);
+		std::atomic<StreamSection*> retired = nullptr;
+		Event finishedEvent;
+	};
+
+	bool canTake(NodeType& node, std::uint16_t affinityIndex, std::uint16_t affinityCount, WorkerMetrics* metrics);
+	void computePriorities();
 	void removeTaskGroup();
+	void onJobFinished();
+
+	NodeType* getAvailableStreamingTask(std::uint16_t affinityIndex, std::uint16_t affinityCount, WorkerMetrics* metrics, bool* hasSkippedTask);
+	void hasComplitedStreaming(NodeType& node);
+	static void releaseFollowUps(NodeType& node);
+	size_t allocateStreamingNode();
+	void* getStreamingSlot(size_t nodeId);
+	NodeType* findStreamingNode(size_t nodeId);
+	void pushReadyTask(NodeType& node);
+	void finishStreamSlots(StreamSection& section, std::uint32_t count);
+	void freeStreamSection(StreamSection* section);
 
 private:
-	//temporary
-	std::mutex m_nodeMutex;
-	std::deque<NodeType> m_nodes;
+	ChunkedArray<NodeType> m_nodes;
+	ChunkedArray<NodeType::EdgeType> m_edges;
 	std::vector<TopologicalRound> m_topological;
 	std::atomic<std::uint32_t> m_currentRound = 0;
 	std::atomic<std::uint32_t> m_refCount = 1;
 	std::atomic<std::uint32_t> m_unfinishedJobNumbers = 0;
+	std::atomic<bool> m_isSubmitted = false;
+	GraphRecorder* m_recorder = nullptr;
+	std::unique_ptr<StreamState> m_stream;
 
 	std::uint16_t m_groupId;
 	TaskGroupPool& m_pool;
+	TaskGroup* m_nextRetired = nullptr;
 };
 
 template<>
@@ -100,27 +199,35 @@ struct HandleArrayItemTraits<TaskGroup>
 	static constexpr bool isStoredId = true;
 };
 
+// Finished groups are not destroyed by the thread that drops the last reference
+// (usually a worker inside hasComplited). They are pushed to a lock-free retired list
+// and destroyed in batches by collect(), which runs on the producer side.
 class TaskGroupPool
 {
 public:
 	using TaskGroupID = std::uint16_t;
 
 public:
-	TaskGroupID createTaskGroup()
-	{
-		return m_pool.emplace(*this);
-	}
+	explicit TaskGroupPool(std::uint32_t size = Detail::POOL_SIZE);
+	~TaskGroupPool();
+
+	// blocks while all size groups are alive; must not be called from inside a task then
+	TaskGroupID createTaskGroup();
+	// returns std::nullopt while all size groups are alive
+	std::optional<TaskGroupID> tryCreateTaskGroup();
 
 	TaskGroup& get(TaskGroupID taskGroupHandle)
 	{
 		return m_pool.get(taskGroupHandle);
 	}
 
-	void removeTaskGroup(TaskGroupID taskGroupHandle)
-	{
-		m_pool.free(taskGroupHandle);
-	}
+	void retireTaskGroup(TaskGroup& group);
+	void collect();
 
 private:
-	HandleArray<TaskGroup, std::uint16_t, 250> m_pool = {};
+	HandleArray<TaskGroup, std::uint16_t> m_pool;
+	const std::uint32_t m_size;
+	std::atomic<TaskGroup*> m_retired = nullptr;
+	std::atomic<std::uint32_t> m_retiredCount = 0;
+	std::atomic<std::uint32_t> m_liveCount = 0;
 };
@@ -1,53 +1,112 @@
 #include "task_group_queue.hpp"
 
 #include "task_group.hpp"
+#include "thread_mailbox.hpp"
 
-void TaskGroupQueue::push(TaskGroup* group)
+TaskGroupQueue::TaskGroupQueue(SchedulerMetrics* metrics, std::atomic<std::uint32_t>* inFlightGroups) noexcept :
+	m_metrics(metrics),
+	m_inFlightGroups(inFlightGroups)
 {
-	group->topological();
+}
+
+TaskGroupQueue::~TaskGroupQueue()
+{
+	// finished groups which no worker has popped yet still hold the reference of the queue
+	while (!m_queue.empty())
+	{
+		releaseGroup(m_queue.front());
+		m_queue.pop();
+	}
+}
+
+bool TaskGroupQueue::push(TaskGroup* group, SchedulingPolicy policy)
+{
+	if (!group->markSubmitted())
+	{
+		return false;
+	}
+
+	// a streaming group queues its nodes itself as they become ready
+	if (!group->isStreaming())
+	{
+		group->topological(policy);
+	}
+
+	// the queue keeps the group alive until it is popped, so a retired group is never seen by a worker
+	group->increaseReferenceCount();
 
 	std::lock_guard guard(m_queueMutex);
 	m_queue.emplace(group);
+	return true;
 }
 
-bool TaskGroupQueue::execute()
+bool TaskGroupQueue::execute(std::uint16_t workerIndex, std::uint16_t affinityIndex, std::uint16_t affinityCount, bool* hasSkippedTask)
 {
 	m_queueMutex.lock();
 
 	for (auto index = 0; index < m_queue.size(); ++index)
 	{
-		auto& taskgroup = m_queue.front();
+		auto* taskgroup = m_queue.front();
 
-		auto task = taskgroup->getAvailableTask();
+		auto task = taskgroup->getAvailableTask(affinityIndex, affinityCount, m_metrics ? &m_metrics->getWorker(workerIndex) : nullptr, hasSkippedTask);
 
 		if (task)
 		{
-			if (taskgroup->isLastTask())
+			// a group whose last task goes to a mailbox stays queued until that task has finished,
+			// so the queue releases every group exactly when it is finished
+			bool isPopped = taskgroup->isLastTask() && !task->getMailbox();
+			if (isPopped)
 			{
 				m_queue.pop();
 			}
 
 			m_queueMutex.unlock();
-			auto& ctx = task->getValue();
-			ctx.job(ctx.data, ctx.returnedValue);
 
-			taskgroup->hasComplited(*task);
+			if (auto* mailbox = task->getMailbox())
+			{
+				// the group stays alive until the owning thread has run the task
+				mailbox->post(*task);
+			}
+			else
+			{
+				taskgroup->runTask(*task, m_metrics, workerIndex);
+			}
+
+			if (isPopped)
+			{
+				releaseGroup(taskgroup);
+			}
 
 			return true;
 		}
 		else
 		{
+			m_queue.pop();
+
 			if (!taskgroup->isFinished())
 			{
-				m_queue.push(std::move(taskgroup));
+				m_queue.push(taskgroup);
+			}
+			else
+			{
+				releaseGroup(taskgroup);
 			}
-			m_queue.pop();
 		}
 	}
 	m_queueMutex.unlock();
 	return false;
 }
 
+void TaskGroupQueue::releaseGroup(TaskGroup* group)
+{
+	if (m_inFlightGroups)
+	{
+		--*m_inFlightGroups;
+	}
+
+	group->decreaseReferenceCount();
+}
+
 size_t TaskGroupQueue::getSize() const
 {
 	std::lock_guard guard(m_queueMutex);
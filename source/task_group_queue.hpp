@@ -2,17 +2,36 @@
 
 #include <queue>
 #include <mutex>
+#include <cstdint>
+#include <atomic>
+
+#include "config.hpp"
 
 class TaskGroup;
+class SchedulerMetrics;
 
 class TaskGroupQueue
 {
 public:
-	void push(TaskGroup* group);
-	bool execute();
+	// inFlightGroups, if given, is decremented whenever the queue lets go of a finished group;
+	// incrementing it is up to the caller of push
+	explicit TaskGroupQueue(SchedulerMetrics* metrics = nullptr, std::atomic<std::uint32_t>* inFlightGroups = nullptr) noexcept;
+	~TaskGroupQueue();
+
+	// returns false if the group had already been pushed
+	bool push(TaskGroup* group, SchedulingPolicy policy = SchedulingPolicy::CriticalPath);
+	// affinityIndex is the position of the worker among the affinityCount workers of the queue's arena,
+	// TaskExecuter::INVALID_WORKER_INDEX for threads which only help out; hasSkippedTask, if given, is set when
+	// nothing was run because the ready tasks prefer other workers
+	bool execute(std::uint16_t workerIndex, std::uint16_t affinityIndex, std::uint16_t affinityCount, bool* hasSkippedTask = nullptr);
 	size_t getSize() const;
 
+private:
+	void releaseGroup(TaskGroup* group);
+
 private:
 	std::queue<TaskGroup*> m_queue;
 	mutable std::mutex m_queueMutex;
+	SchedulerMetrics* m_metrics;
+	std::atomic<std::uint32_t>* m_inFlightGroups;
 };
@@ -1,14 +1,34 @@
 #pragma once
 
+#include "affinity.hpp"
+#include "metrics.hpp"
 #include "task_executor.hpp"
 #include "utils/event.hpp"
+#include "utils/time_utils.hpp"
 
 class TaskGroup;
+class ThreadMailbox;
+
+template<class IndexType>
+struct TaskEdge
+{
+	IndexType node;
+	TaskEdge* next = nullptr;
+};
+
+// called once by the worker which finishes the task, e.g. to resume a coroutine waiting for it
+struct TaskContinuation
+{
+	void(*callback)(void* context) = nullptr;
+	void* context = nullptr;
+};
 
 template<class ValueType, class IndexType>
 class TaskNode
 {
 public:
+	using EdgeType = TaskEdge<IndexType>;
+
 	template<class Value = ValueType>
 	TaskNode(TaskGroup& tg, IndexType id, Value&& value) : m_value(std::forward<Value>(value)), m_ID(id), m_group(&tg), m_unfinishedParentTasks(0)
 	{}
@@ -21,34 +41,92 @@ public:
 		m_unfinishedParentTasks(0)
 	{}
 
-	TaskNode(TaskNode&& value) noexcept :
-		m_adjanced(std::move(value.m_adjanced)),
-		m_parents(std::move(value.m_parents)),
-		m_value(std::move(value.m_value)),
-		m_group(std::move(value.m_group)),
-		m_ID(value.m_ID),
-		m_unfinishedParentTasks(value.m_unfinishedParentTasks.load())
-	{}
+	TaskNode(const TaskNode&) = delete;
+	TaskNode& operator=(const TaskNode&) = delete;
 
-	void addAdjancedNode(const IndexType& nodeIndex)
+	// edges are pushed with a CAS, so several threads can link the same node at once
+	void addAdjancedNode(EdgeType& edge)
 	{
-		m_adjanced.emplace_back(nodeIndex);
+		pushEdge(m_adjanced, edge);
 	}
 
-	void addParent(const IndexType& nodeIndex)
+	void addParent(EdgeType& edge)
 	{
-		m_parents.emplace_back(nodeIndex);
+		pushEdge(m_parents, edge);
+		++m_parentsCount;
 		++this->m_unfinishedParentTasks;
 	}
 
-	const std::vector<IndexType>& getAdjancedNodes() const
+	// for nodes linked while their parents may already run (streaming groups): returns false
+	// if the node has finished and closed its list with closeAdjancedNodes
+	bool tryAddAdjancedNode(EdgeType& edge)
 	{
-		return m_adjanced;
+		auto* next = m_adjanced.load(std::memory_order_relaxed);
+		do
+		{
+			if (next == getClosedMarker())
+			{
+				return false;
+			}
+			edge.next = next;
+		} while (!m_adjanced.compare_exchange_weak(next, &edge, std::memory_order_release, std::memory_order_relaxed));
+
+		return true;
 	}
 
-	const std::vector<IndexType>& getParentsNodes() const
+	// takes the list over from the node, later tryAddAdjancedNode calls fail
+	EdgeType* closeAdjancedNodes()
 	{
-		return m_parents;
+		auto* head = m_adjanced.exchange(getClosedMarker(), std::memory_order_acq_rel);
+		return head == getClosedMarker() ? nullptr : head;
+	}
+
+	// counts a parent before it is linked, so the node cannot become available in between
+	void addUnfinishedParent()
+	{
+		++m_unfinishedParentTasks;
+	}
+
+	// a task of another group which waits for this one, see Task::then; returns false if this
+	// task has already released its follow-ups, then the task does not have to be waited for
+	bool tryAddFollowUp(TaskNode& node)
+	{
+		// the list is closed by pointing it at the node itself
+		auto* next = m_followUps.load(std::memory_order_relaxed);
+		do
+		{
+			if (next == this)
+			{
+				return false;
+			}
+			node.m_nextFollowUp = next;
+		} while (!m_followUps.compare_exchange_weak(next, &node, std::memory_order_release, std::memory_order_relaxed));
+
+		return true;
+	}
+
+	// takes the list over from the task, later tryAddFollowUp calls fail
+	TaskNode* closeFollowUps()
+	{
+		auto* head = m_followUps.exchange(this, std::memory_order_acq_rel);
+		return head == this ? nullptr : head;
+	}
+
+	TaskNode* getNextFollowUp() const
+	{
+		return m_nextFollowUp;
+	}
+
+	template<typename Callable>
+	void forEachAdjancedNode(Callable&& callable) const
+	{
+		forEachEdge(m_adjanced, std::forward<Callable>(callable));
+	}
+
+	template<typename Callable>
+	void forEachParentNode(Callable&& callable) const
+	{
+		forEachEdge(m_parents, std::forward<Callable>(callable));
 	}
 
 	ValueType& getValue()
@@ -68,7 +146,7 @@ public:
 
 	size_t getParentsCount() const
 	{
-		return m_parents.size();
+		return m_parentsCount;
 	}
 
 	bool isAvailable() const
@@ -76,10 +154,42 @@ public:
 		return m_unfinishedParentTasks == 0;
 	}
 
-	void onParentTaskFinished()
+	// returns true for the call which makes the task available
+	bool onParentTaskFinished()
 	{
 		assert(m_unfinishedParentTasks > 0);
-		--m_unfinishedParentTasks;
+
+		// stored before the decrement, so a worker which sees the task available also sees the time
+		m_readyTime.store(getTimestamp(), std::memory_order_relaxed);
+		return --m_unfinishedParentTasks == 0;
+	}
+
+	// timestamps (see getTimestamp) of the moment the task became ready and of its execution
+	void setReadyTime(std::uint64_t time)
+	{
+		m_readyTime.store(time, std::memory_order_relaxed);
+	}
+
+	std::uint64_t getReadyTime() const
+	{
+		return m_readyTime.load(std::memory_order_relaxed);
+	}
+
+	void setRunTimes(std::uint64_t startTime, std::uint64_t finishTime)
+	{
+		m_startTime = startTime;
+		m_finishTime = finishTime;
+	}
+
+	std::uint64_t getExecutionTime() const
+	{
+		return m_finishTime - m_startTime;
+	}
+
+	// complete once the task has finished
+	TaskProfile getProfile() const
+	{
+		return TaskProfile{ getReadyTime(), m_startTime, m_finishTime };
 	}
 
 	IndexType getID()
@@ -87,6 +197,69 @@ public:
 		return m_ID;
 	}
 
+	// expected execution time in nanoseconds, 0 means "not given"
+	void setCost(std::uint64_t cost)
+	{
+		m_cost = cost;
+	}
+
+	std::uint64_t getCost() const
+	{
+		return m_cost;
+	}
+
+	void setAffinity(size_t key)
+	{
+		m_affinity = key;
+	}
+
+	size_t getAffinity() const
+	{
+		return m_affinity;
+	}
+
+	// a task with a mailbox is executed by the thread owning the mailbox
+	void setMailbox(ThreadMailbox* mailbox)
+	{
+		m_mailbox = mailbox;
+	}
+
+	ThreadMailbox* getMailbox() const
+	{
+		return m_mailbox;
+	}
+
+	// counts how often a worker other than the preferred one passed over the ready task
+	std::uint32_t skipByOtherWorker()
+	{
+		return ++m_skipCount;
+	}
+
+	void setPriority(std::uint64_t priority)
+	{
+		m_priority = priority;
+	}
+
+	std::uint64_t getPriority() const
+	{
+		return m_priority;
+	}
+
+	void submit(TaskExecuter& executor, TaskExecuter::ArenaID arena)
+	{
+		executor.push(*m_group, arena);
+	}
+
+	bool trySubmit(TaskExecuter& executor, TaskExecuter::ArenaID arena)
+	{
+		return executor.tryPush(*m_group, arena);
+	}
+
+	bool submitFor(TaskExecuter& executor, std::chrono::nanoseconds timeout, TaskExecuter::ArenaID arena)
+	{
+		return executor.pushFor(*m_group, timeout, arena);
+	}
+
 	void wait(TaskExecuter& executor)
 	{
 		executor.push(*m_group);
@@ -95,7 +268,63 @@ public:
 
 	void fireOnFinishedEvent()
 	{
+		auto* continuation = m_continuation.exchange(getFinishedMarker(), std::memory_order_acq_rel);
 		m_finishedEvent.notify();
+
+		if (continuation)
+		{
+			continuation->callback(continuation->context);
+		}
+	}
+
+	bool isFinished() const
+	{
+		return m_continuation.load(std::memory_order_acquire) == getFinishedMarker();
+	}
+
+	// a task has at most one continuation, which has to stay alive until it is called;
+	// returns false if the task has already finished, then the continuation is never called
+	bool setContinuation(TaskContinuation& continuation)
+	{
+		TaskContinuation* expected = nullptr;
+		if (m_continuation.compare_exchange_strong(expected, &continuation, std::memory_order_acq_rel))
+		{
+			return true;
+		}
+
+		assert(expected == getFinishedMarker());
+		return false;
+	}
+
+private:
+	static TaskContinuation* getFinishedMarker()
+	{
+		static TaskContinuation marker;
+		return &marker;
+	}
+
+	static EdgeType* getClosedMarker()
+	{
+		static EdgeType marker{};
+		return &marker;
+	}
+
+	static void pushEdge(std::atomic<EdgeType*>& head, EdgeType& edge)
+	{
+		auto* next = head.load(std::memory_order_relaxed);
+		do
+		{
+			edge.next = next;
+		} while (!head.compare_exchange_weak(next, &edge, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	template<typename Callable>
+	static void forEachEdge(const std::atomic<EdgeType*>& head, Callable&& callable)
+	{
+		for (auto* edge = head.load(std::memory_order_acquire); edge; edge = edge->next)
+		{
+			callable(edge->node);
+		}
 	}
 
 private:
@@ -103,10 +332,26 @@ private:
 	ValueType m_value;
 	TaskGroup* m_group;
 
-	std::vector<IndexType> m_adjanced;
-	std::vector<IndexType> m_parents;
+	std::atomic<EdgeType*> m_adjanced = nullptr;
+	std::atomic<EdgeType*> m_parents = nullptr;
+	std::atomic<std::uint32_t> m_parentsCount = 0;
 	std::atomic<std::uint32_t> m_unfinishedParentTasks;
 
+	std::uint64_t m_cost = 0;
+	std::uint64_t m_priority = 0;
+
+	size_t m_affinity = Affinity::NONE;
+	std::uint32_t m_skipCount = 0;
+	ThreadMailbox* m_mailbox = nullptr;
+
+	std::atomic<std::uint64_t> m_readyTime = 0;
+	std::uint64_t m_startTime = 0;
+	std::uint64_t m_finishTime = 0;
+
 	Event m_finishedEvent;
+	std::atomic<TaskContinuation*> m_continuation = nullptr;
+
+	std::atomic<TaskNode*> m_followUps = nullptr;
+	TaskNode* m_nextFollowUp = nullptr;
 };
 
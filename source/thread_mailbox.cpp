@@ -0,0 +1,109 @@
+#include "thread_mailbox.hpp"
+
+#include <cassert>
+#include <limits>
+#include <map>
+
+#include "task_executor.hpp"
+
+namespace
+{
+	thread_local ThreadMailbox* t_mailbox = nullptr;
+
+	std::mutex g_registryMutex;
+	std::map<std::string, ThreadMailbox*> g_registry;
+}
+
+ThreadMailbox::ThreadMailbox(TaskExecuter& executor, std::string name) :
+	m_executor(executor),
+	m_name(std::move(name))
+{
+	std::lock_guard guard(g_registryMutex);
+	[[maybe_unused]] bool isInserted = g_registry.emplace(m_name, this).second;
+	assert(isInserted);
+}
+
+ThreadMailbox::~ThreadMailbox()
+{
+	assert(m_tasks.empty());
+
+	if (t_mailbox == this)
+	{
+		t_mailbox = nullptr;
+	}
+
+	std::lock_guard guard(g_registryMutex);
+	g_registry.erase(m_name);
+}
+
+void ThreadMailbox::bindToCurrentThread()
+{
+	m_ownerThread = std::this_thread::get_id();
+	t_mailbox = this;
+}
+
+size_t ThreadMailbox::pump()
+{
+	return runPending(std::numeric_limits<size_t>::max());
+}
+
+size_t ThreadMailbox::runPending(size_t budget)
+{
+	assert(m_ownerThread == std::thread::id() || m_ownerThread == std::this_thread::get_id());
+
+	size_t executed = 0;
+	while (executed < budget)
+	{
+		TaskGroup::NodeType* node = nullptr;
+		{
+			std::lock_guard guard(m_mutex);
+			if (m_tasks.empty())
+			{
+				break;
+			}
+
+			node = m_tasks.front();
+			m_tasks.pop_front();
+		}
+
+		node->getGroup().runTask(*node, &m_executor.getMetricsRecorder(), TaskExecuter::INVALID_WORKER_INDEX);
+		++executed;
+	}
+
+	if (executed != 0)
+	{
+		// continuations of the executed tasks may be ready now
+		m_executor.wakeWorkers();
+	}
+
+	return executed;
+}
+
+void ThreadMailbox::post(TaskGroup::NodeType& node)
+{
+	std::lock_guard guard(m_mutex);
+	m_tasks.push_back(&node);
+}
+
+size_t ThreadMailbox::getSize() const
+{
+	std::lock_guard guard(m_mutex);
+	return m_tasks.size();
+}
+
+const std::string& ThreadMailbox::getName() const noexcept
+{
+	return m_name;
+}
+
+ThreadMailbox* ThreadMailbox::find(const std::string& name)
+{
+	std::lock_guard guard(g_registryMutex);
+	auto it = g_registry.find(name);
+	return it != g_registry.end() ? it->second : nullptr;
+}
+
+ThreadMailbox* ThreadMailbox::getCurrent() noexcept
+{
+	return t_mailbox;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "task_group.hpp"
+
+class TaskExecuter;
+
+// Holds the tasks which have to run on one particular thread, e.g. the owner of a
+// non thread-safe API. Workers park such tasks here when they become ready, and the
+// thread executes them in pump()/runPending(). The tasks stay part of their group, so
+// their continuations are picked up by the workers as usual.
+// The owning thread must not block in Task::wait on a task which depends on a parked one.
+class ThreadMailbox
+{
+public:
+	ThreadMailbox(TaskExecuter& executor, std::string name);
+	~ThreadMailbox();
+
+	ThreadMailbox(const ThreadMailbox&) = delete;
+	ThreadMailbox& operator=(const ThreadMailbox&) = delete;
+
+	// makes the mailbox the one of the calling thread, see getCurrent()
+	void bindToCurrentThread();
+
+	// runs every parked task, returns how many were executed
+	size_t pump();
+	// runs at most budget parked tasks, returns how many were executed
+	size_t runPending(size_t budget);
+
+	void post(TaskGroup::NodeType& node);
+	size_t getSize() const;
+
+	const std::string& getName() const noexcept;
+
+	static ThreadMailbox* find(const std::string& name);
+	static ThreadMailbox* getCurrent() noexcept;
+
+private:
+	TaskExecuter& m_executor;
+	const std::string m_name;
+	std::thread::id m_ownerThread;
+
+	mutable std::mutex m_mutex;
+	std::deque<TaskGroup::NodeType*> m_tasks;
+};
+
+// tag which binds a task to the thread owning the mailbox
+struct OnThread
+{
+	ThreadMailbox* mailbox = nullptr;
+
+	// the mailbox bound to the calling thread
+	static OnThread current() noexcept
+	{
+		return OnThread{ ThreadMailbox::getCurrent() };
+	}
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Detail
+{
+	inline std::uint32_t highestBit(std::uint64_t value) noexcept
+	{
+		assert(value != 0);
+#if defined(_MSC_VER)
+		unsigned long index = 0;
+		_BitScanReverse64(&index, value);
+		return static_cast<std::uint32_t>(index);
+#else
+		return 63u - static_cast<std::uint32_t>(__builtin_clzll(value));
+#endif
+	}
+}
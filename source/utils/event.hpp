@@ -29,5 +29,5 @@ public:
 private:
 	std::mutex m_mutex;
 	std::condition_variable m_cv;
-	volatile bool m_signaled = false;
+	bool m_signaled = false;
 };
@@ -20,6 +20,18 @@ void Semaphore::wait() noexcept
 	--m_count;
 }
 
+bool Semaphore::waitFor(std::chrono::nanoseconds timeout) noexcept
+{
+	std::unique_lock lck(m_mutex);
+	if (!m_cv.wait_for(lck, timeout, [this]() { return this->m_count > 0; }))
+	{
+		return false;
+	}
+
+	--m_count;
+	return true;
+}
+
 void Semaphore::notify() noexcept
 {
 	std::unique_lock lck(m_mutex);
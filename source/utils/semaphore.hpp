@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 class Semaphore
 {
@@ -13,6 +14,8 @@ public:
 	Semaphore(Semaphore&& other) noexcept;
 
 	void wait() noexcept;
+	// returns false if the timeout expired before the semaphore was signaled
+	bool waitFor(std::chrono::nanoseconds timeout) noexcept;
 	void notify() noexcept;
 	void notifyAll() noexcept;
 
@@ -20,5 +23,5 @@ private:
 	std::mutex m_mutex;
 	std::condition_variable m_cv;
 	const std::uint32_t MAX_COUNT;
-	volatile std::uint32_t m_count;
+	std::uint32_t m_count;
 };
@@ -1,5 +1,11 @@
 #include "time_utils.hpp"
 
+std::uint64_t getTimestamp() noexcept
+{
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
 ScopedTimer::ScopedTimer(std::uint64_t& timeStore) noexcept : 
 	m_timeStorage{ timeStore },
 	m_start{ std::chrono::high_resolution_clock::now() }
@@ -2,6 +2,9 @@
 #include <cstdint>
 #include <chrono>
 
+// monotonic timestamp in nanoseconds, only differences between timestamps are meaningful
+std::uint64_t getTimestamp() noexcept;
+
 class ScopedTimer
 {
 public:
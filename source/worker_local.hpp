@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <cassert>
+
+#include "config.hpp"
+#include "task_executor.hpp"
+
+// One value per worker of a TaskExecuter, each on its own cache line, so jobs can
+// accumulate without atomics and the results are combined after the jobs are joined.
+// Threads helping out in TaskExecuter::push have slots of their own. Threads outside the executor,
+// e.g. the owner of a ThreadMailbox, share one extra slot, so only one of them may use it at a time.
+template<typename ValueType>
+class WorkerLocal
+{
+public:
+	explicit WorkerLocal(const TaskExecuter& executor, const ValueType& initialValue = ValueType{}) :
+		m_executor(executor),
+		m_initialValue(initialValue),
+		m_slots(executor.getSlotCount() + 1, Slot{ initialValue })
+	{}
+
+	ValueType& local() noexcept
+	{
+		auto index = m_executor.getCurrentWorkerIndex();
+		if (index == TaskExecuter::INVALID_WORKER_INDEX)
+		{
+			return m_slots.back().value;
+		}
+
+		assert(index < m_slots.size() - 1);
+		return m_slots[index].value;
+	}
+
+	template<typename BinaryOperation>
+	ValueType combine(BinaryOperation&& operation) const
+	{
+		ValueType result = m_initialValue;
+		for (const auto& slot : m_slots)
+		{
+			result = operation(result, slot.value);
+		}
+		return result;
+	}
+
+	template<typename Callable>
+	void forEach(Callable&& callable)
+	{
+		for (auto& slot : m_slots)
+		{
+			callable(slot.value);
+		}
+	}
+
+	void clear()
+	{
+		for (auto& slot : m_slots)
+		{
+			slot.value = m_initialValue;
+		}
+	}
+
+	size_t size() const noexcept
+	{
+		return m_slots.size();
+	}
+
+private:
+	struct alignas(Detail::CACHE_LINE_SIZE) Slot
+	{
+		ValueType value;
+	};
+
+	const TaskExecuter& m_executor;
+	const ValueType m_initialValue;
+	std::vector<Slot> m_slots;
+};
@@ -0,0 +1,900 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../source/algorithms.hpp"
+#include "../source/data_parallel.hpp"
+#include "../source/graph_capture.hpp"
+#include "../source/pipeline.hpp"
+#include "../source/streaming_graph.hpp"
+#include "../source/task_factory.hpp"
+#include "../source/task_executor.hpp"
+#include "../source/thread_mailbox.hpp"
+#include "../source/worker_local.hpp"
+
+#if defined(__cpp_impl_coroutine)
+#include "../source/coroutine.hpp"
+#endif
+
+#include "../source/utils/time_utils.hpp"
+
+// Stress tests of the scheduler, meant to be run under ThreadSanitizer and AddressSanitizer
+// as well (see JOB_SYSTEM_SANITIZER in CMakeLists.txt):
+//   stress_test [iterations]   runs every test with 1, 2, 4 and hardware_concurrency workers
+//   stress_test --sweep        reports the throughput of wide graphs for 1 .. hardware_concurrency workers
+// The coroutine test is built only in C++20 builds (JOB_SYSTEM_COROUTINES).
+
+namespace
+{
+	std::uint32_t g_failureCount = 0;
+
+	void check(bool condition, const char* test, const char* message)
+	{
+		if (!condition)
+		{
+			++g_failureCount;
+			std::cout << "FAILED " << test << ": " << message << std::endl;
+		}
+	}
+
+	void busyWork(std::uint64_t duration)
+	{
+		const auto start = getTimestamp();
+		while (getTimestamp() - start < duration)
+		{}
+	}
+
+	// the slot of a group is released right after its last task, give the workers a moment
+	bool waitForReleasedGroups(TaskExecuter& executor)
+	{
+		const auto deadline = getTimestamp() + 5'000'000'000ull;
+		while (executor.getInFlightGroupCount() != 0 && getTimestamp() < deadline)
+		{
+			std::this_thread::yield();
+		}
+		return executor.getInFlightGroupCount() == 0;
+	}
+
+	// every node checks that all of its parents have run before it
+	void testRandomGraphs(TaskFactory& factory, TaskExecuter& executor, std::mt19937& random, std::uint32_t iterations)
+	{
+		for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			const size_t nodeCount = 1 + random() % 200;
+
+			std::vector<std::vector<size_t>> parents(nodeCount);
+			for (size_t node = 1; node < nodeCount; ++node)
+			{
+				const auto parentCount = random() % 4;
+				for (std::uint32_t index = 0; index < parentCount; ++index)
+				{
+					parents[node].push_back(random() % node);
+				}
+			}
+
+			auto finished = std::make_unique<std::atomic<bool>[]>(nodeCount);
+			std::atomic<size_t> runCount = 0;
+			std::atomic<bool> isOrdered = true;
+
+			auto& group = factory.createTaskGroup();
+			for (size_t node = 0; node < nodeCount; ++node)
+			{
+				group.addNode([&, node]()
+				{
+					for (auto parent : parents[node])
+					{
+						if (!finished[parent])
+						{
+							isOrdered = false;
+						}
+					}
+					finished[node] = true;
+					++runCount;
+				});
+			}
+
+			// half of the graphs are linked from two threads at once
+			auto linkRange = [&](size_t begin, size_t end)
+			{
+				for (size_t node = begin; node < end; ++node)
+				{
+					for (auto parent : parents[node])
+					{
+						group.link(parent, node);
+					}
+				}
+			};
+
+			if (iteration % 2 == 0)
+			{
+				std::thread linker(linkRange, 0, nodeCount / 2);
+				linkRange(nodeCount / 2, nodeCount);
+				linker.join();
+			}
+			else
+			{
+				linkRange(0, nodeCount);
+			}
+
+			for (size_t node = 0; node < nodeCount; node += 7)
+			{
+				group.getTaskNode(node)->setAffinity(random());
+			}
+
+			const auto join = group.addNode([]() {});
+			for (size_t node = 0; node < nodeCount; ++node)
+			{
+				group.link(node, join);
+			}
+
+			Task<void> joinTask(group.getTaskNode(join));
+			joinTask.wait(executor);
+
+			check(runCount == nodeCount, "random graphs", "not every node has run");
+			check(isOrdered, "random graphs", "a node has run before its parent");
+
+			const auto profile = joinTask.getProfile();
+			check(profile.readyTime <= profile.startTime && profile.startTime <= profile.finishTime, "random graphs", "task profile out of order");
+			check(joinTask.getGroupProfile().taskCount == nodeCount + 1, "random graphs", "group profile misses tasks");
+		}
+	}
+
+	// nodes are added while earlier ones run, parents are picked among the recent nodes
+	// so that whole sections finish and are released while the graph grows
+	void testStreamingGraphs(TaskFactory& factory, TaskExecuter& executor, std::mt19937& random, std::uint32_t iterations)
+	{
+		constexpr size_t window = 64;
+
+		for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			const size_t nodeCount = 1 + random() % (8 * Detail::STREAM_SECTION_SIZE);
+
+			auto finished = std::make_unique<std::atomic<bool>[]>(nodeCount);
+			std::atomic<size_t> runCount = 0;
+			std::atomic<bool> isOrdered = true;
+
+			StreamingGraph graph(factory, executor);
+			std::vector<StreamingGraph::NodeID> parents;
+			for (size_t node = 0; node < nodeCount; ++node)
+			{
+				parents.clear();
+				const auto parentCount = node == 0 ? 0 : random() % 4;
+				for (std::uint32_t index = 0; index < parentCount; ++index)
+				{
+					parents.push_back(node - 1 - random() % std::min(node, window));
+				}
+
+				const auto id = graph.addNodeAfter(parents, [&, parents, node]()
+				{
+					for (auto parent : parents)
+					{
+						if (!finished[parent])
+						{
+							isOrdered = false;
+						}
+					}
+					finished[node] = true;
+					++runCount;
+				});
+				check(id == node, "streaming graphs", "unexpected node id");
+
+				if (node % 7 == 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			graph.wait();
+
+			check(runCount == nodeCount, "streaming graphs", "not every node has run");
+			check(isOrdered, "streaming graphs", "a node has run before its parent");
+		}
+	}
+
+	// jobs which block on tasks they create themselves
+	void testNestedWaits(TaskFactory& factory, TaskExecuter& executor, std::uint32_t iterations)
+	{
+		// a waiting job blocks its worker, so at least one worker has to stay free
+		const std::uint32_t depth = std::min<std::uint32_t>(executor.getThreadCount() - 1, 3);
+		if (depth == 0)
+		{
+			return;
+		}
+
+		for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			std::atomic<std::uint32_t> leafCount = 0;
+
+			std::function<std::uint32_t(std::uint32_t)> nested = [&](std::uint32_t level) -> std::uint32_t
+			{
+				if (level == depth)
+				{
+					++leafCount;
+					return 1;
+				}
+
+				auto child = factory.createTask(nested, level + 1);
+				child.wait(executor);
+				return child.get() + 1;
+			};
+
+			auto root = factory.createTask(nested, std::uint32_t{ 0 });
+			root.wait(executor);
+
+			check(root.get() == depth + 1, "nested waits", "wrong result");
+			check(leafCount == 1, "nested waits", "leaf has not run exactly once");
+		}
+	}
+
+	// a continuation of a task whose group has already run starts a group of its own
+	void testContinuationAfterWait(TaskFactory& factory, TaskExecuter& executor, std::uint32_t iterations)
+	{
+		for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			auto task = factory.createTask([iteration]() { return iteration; });
+			task.wait(executor);
+
+			auto continuation = task.then([](Task<std::uint32_t>& parent) { return parent.get() + 1; });
+			continuation.wait(executor);
+
+			check(continuation.get() == iteration + 1, "continuation after wait", "wrong result");
+		}
+	}
+
+	// then on a task whose group is submitted but may still be running
+	void testContinuationAfterSubmit(TaskFactory& factory, TaskExecuter& executor, std::uint32_t iterations)
+	{
+		for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			auto task = factory.createTask([iteration]()
+			{
+				busyWork(iteration % 4 * 10'000);
+				return iteration;
+			});
+			task.submit(executor);
+
+			auto continuation = task.then([](Task<std::uint32_t>& parent)
+			{
+				check(parent.isFinished(), "continuation after submit", "continuation ran before its task");
+				return parent.get() + 1;
+			});
+			auto tail = continuation.then([](Task<std::uint32_t>& parent) { return parent.get() + 1; });
+			tail.wait(executor);
+
+			check(tail.get() == iteration + 2, "continuation after submit", "wrong result");
+		}
+	}
+
+	// a slow drift of the durations, each step below the tolerance, still reaches the shared estimate
+	void testCostEstimate()
+	{
+		std::atomic<std::uint64_t> estimate = 0;
+		for (std::uint32_t sample = 0; sample < 64; ++sample)
+		{
+			Detail::updateCostEstimate(&estimate, 1000);
+		}
+		check(estimate == 1000, "cost estimate", "stable durations are not published");
+
+		for (std::uint32_t sample = 0; sample < 256; ++sample)
+		{
+			Detail::updateCostEstimate(&estimate, 1200);
+		}
+		check(estimate > 1130 && estimate <= 1200, "cost estimate", "the estimate does not follow the durations");
+	}
+
+	// tryCreateTask fails instead of blocking while the held tasks fill the pool
+	void testPoolLimit(std::uint16_t workerCount)
+	{
+		constexpr std::uint32_t poolSize = 4;
+
+		SchedulerConfig config;
+		config.maxTaskGroupCount = poolSize;
+		TaskFactory factory(config);
+		// destroyed first, the workers may still hold the finished groups
+		TaskExecuter executor(workerCount);
+
+		std::vector<Task<std::uint32_t>> tasks;
+		for (std::uint32_t index = 0; index < poolSize; ++index)
+		{
+			tasks.push_back(factory.tryCreateTask([index]() { return index; }));
+			check(tasks.back().isValid(), "pool limit", "a group below the limit was refused");
+		}
+
+		check(!factory.tryCreateTask([]() { return 0u; }).isValid(), "pool limit", "a group above the limit was created");
+		check(factory.tryCreateTaskGroup() == nullptr, "pool limit", "a group above the limit was created");
+
+		for (std::uint32_t index = 0; index < poolSize; ++index)
+		{
+			tasks[index].wait(executor);
+			check(tasks[index].get() == index, "pool limit", "wrong result");
+		}
+		tasks.clear();
+
+		// the workers drop their references to the finished groups shortly after the waits return
+		Task<std::uint32_t> task;
+		const auto deadline = getTimestamp() + 5'000'000'000ull;
+		while (!task.isValid() && getTimestamp() < deadline)
+		{
+			std::this_thread::yield();
+			task = factory.tryCreateTask([]() { return 1u; });
+		}
+		check(task.isValid(), "pool limit", "finished groups are not reused");
+
+		task.wait(executor);
+		check(task.get() == 1, "pool limit", "wrong result");
+	}
+
+	// several producers share the factory and the executor, optionally with an in-flight limit
+	void testConcurrentSubmission(TaskFactory& factory, TaskExecuter& executor, std::uint32_t iterations, std::uint32_t maxInFlightGroups)
+	{
+		constexpr std::uint32_t producerCount = 4;
+		constexpr std::uint32_t chainLength = 4;
+		constexpr size_t producerBatchSize = Detail::POOL_SIZE / producerCount / 2;
+
+		executor.setMaxInFlightGroups(maxInFlightGroups);
+
+		std::atomic<std::uint32_t> runCount = 0;
+		std::vector<std::thread> producers;
+		for (std::uint32_t producer = 0; producer < producerCount; ++producer)
+		{
+			producers.emplace_back([&]()
+			{
+				std::vector<Task<void>> tails;
+				for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+				{
+					auto task = factory.createTask([&]() { ++runCount; });
+					auto tail = task;
+					for (std::uint32_t index = 1; index < chainLength; ++index)
+					{
+						tail = tail.then([&](Task<void>&) { ++runCount; });
+					}
+
+					task.submit(executor);
+					tails.push_back(tail);
+
+					// a held Task keeps its group alive, so no producer may hold too many of the pool's slots
+					if (tails.size() == producerBatchSize || iteration + 1 == iterations)
+					{
+						for (auto& waited : tails)
+						{
+							waited.wait(executor);
+						}
+						tails.clear();
+					}
+				}
+			});
+		}
+
+		for (auto& producer : producers)
+		{
+			producer.join();
+		}
+
+		executor.setMaxInFlightGroups(0);
+
+		check(runCount == producerCount * iterations * chainLength, "concurrent submission", "not every task has run");
+		check(waitForReleasedGroups(executor), "concurrent submission", "in-flight groups are not released");
+	}
+
+	// producers blocked by the in-flight limit run tasks themselves; every task counts in its
+	// WorkerLocal slot without atomics, so a slot used by two threads at once shows up under TSAN
+	void testAdmissionHelping(TaskFactory& factory, TaskExecuter& executor, std::uint32_t iterations)
+	{
+		constexpr std::uint32_t producerCount = Detail::MAX_HELPER_COUNT + 2;
+		constexpr std::uint32_t taskCount = 8;
+		constexpr size_t producerBatchSize = Detail::POOL_SIZE / producerCount / 2;
+
+		WorkerLocal<std::uint64_t> counts(executor, 0);
+		const auto before = executor.getMetrics();
+		executor.setMaxInFlightGroups(2);
+
+		std::vector<std::thread> producers;
+		for (std::uint32_t producer = 0; producer < producerCount; ++producer)
+		{
+			producers.emplace_back([&]()
+			{
+				std::vector<Task<void>> joins;
+				for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+				{
+					auto& group = factory.createTaskGroup();
+					const auto join = group.addNode([]() {});
+					for (std::uint32_t index = 0; index < taskCount; ++index)
+					{
+						group.link(group.addNode([&counts]() { busyWork(1000); ++counts.local(); }), join);
+					}
+
+					Task<void> joinTask(group.getTaskNode(join));
+					joinTask.submit(executor);
+					joins.push_back(joinTask);
+
+					if (joins.size() == producerBatchSize || iteration + 1 == iterations)
+					{
+						for (auto& waited : joins)
+						{
+							waited.wait(executor);
+						}
+						joins.clear();
+					}
+				}
+			});
+		}
+
+		for (auto& producer : producers)
+		{
+			producer.join();
+		}
+
+		executor.setMaxInFlightGroups(0);
+
+		const std::uint64_t expected = std::uint64_t(producerCount) * iterations * taskCount;
+		check(counts.combine(std::plus<>()) == expected, "admission helping", "lost updates in WorkerLocal");
+
+		std::uint64_t outsideCount = 0;
+		counts.forEach([&outsideCount](std::uint64_t value) { outsideCount = value; });
+		check(outsideCount == 0, "admission helping", "a helping thread used the slot of threads outside the executor");
+
+		// tasks are counted before their group is released
+		check(waitForReleasedGroups(executor), "admission helping", "in-flight groups are not released");
+
+		const auto after = executor.getMetrics();
+		const std::uint64_t expectedTasks = expected + std::uint64_t(producerCount) * iterations;
+		std::uint64_t executed = 0;
+		for (size_t index = 0; index < after.workers.size(); ++index)
+		{
+			executed += after.workers[index].tasksExecuted - before.workers[index].tasksExecuted;
+		}
+		check(executed == expectedTasks, "admission helping", "metrics miss tasks");
+		check(after.workers.back().tasksExecuted == before.workers.back().tasksExecuted, "admission helping", "metrics of outside threads count helped tasks");
+		check(after.execution.count - before.execution.count == expectedTasks, "admission helping", "execution histogram misses tasks");
+	}
+
+	// an arena's groups run only on its own workers while the default arena is resized;
+	// affinity keys map onto the workers of the arena, so its only worker never passes over a task
+	void testArenas(std::uint16_t workerCount, std::mt19937& random, std::uint32_t iterations)
+	{
+		if (workerCount < 2)
+		{
+			return;
+		}
+
+		TaskFactory factory;
+		TaskExecuter executor(1, workerCount);
+		const auto arena = executor.createArena("stress", 1, false);
+
+		auto isDefaultWorker = std::make_unique<std::atomic<bool>[]>(executor.getSlotCount());
+		auto isArenaWorker = std::make_unique<std::atomic<bool>[]>(executor.getSlotCount());
+		auto markWorker = [&executor](std::atomic<bool>* workers)
+		{
+			const auto index = executor.getCurrentWorkerIndex();
+			if (index < executor.getThreadCount())
+			{
+				workers[index] = true;
+			}
+		};
+
+		std::atomic<std::uint32_t> runCount = 0;
+		for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			if (iteration % 4 == 0)
+			{
+				executor.resize(1, iteration % 8 == 0 ? workerCount - 1 : 1);
+			}
+
+			std::vector<Task<void>> tasks;
+			for (std::uint32_t index = 0; index < 8; ++index)
+			{
+				const bool isInArena = index % 2 == 0;
+				auto task = factory.createTask([&, isInArena]()
+				{
+					markWorker(isInArena ? isArenaWorker.get() : isDefaultWorker.get());
+					busyWork(2000);
+					++runCount;
+				});
+				task.submit(executor, isInArena ? arena : TaskExecuter::DEFAULT_ARENA);
+				tasks.push_back(task);
+			}
+
+			for (auto& task : tasks)
+			{
+				task.wait(executor);
+			}
+		}
+
+		check(runCount == iterations * 8, "arenas", "not every task has run");
+		check(executor.getActiveThreadCount() <= executor.getThreadCount(), "arenas", "more workers than slots");
+		for (std::uint16_t index = 0; index < executor.getThreadCount(); ++index)
+		{
+			check(!(isDefaultWorker[index] && isArenaWorker[index]), "arenas", "a worker has run tasks of both arenas");
+		}
+
+		auto countStealAttempts = [&executor]()
+		{
+			std::uint64_t result = 0;
+			for (const auto& worker : executor.getMetrics().workers)
+			{
+				result += worker.stealsAttempted;
+			}
+			return result;
+		};
+
+		const auto stealAttempts = countStealAttempts();
+		auto& group = factory.createTaskGroup();
+		for (std::uint32_t index = 0; index < 64; ++index)
+		{
+			const auto node = group.addNode([]() { busyWork(500); });
+			group.getTaskNode(node)->setAffinity(random());
+		}
+		const auto join = group.addNode([]() {});
+		for (std::uint32_t index = 0; index < 64; ++index)
+		{
+			group.link(index, join);
+		}
+
+		Task<void> joinTask(group.getTaskNode(join));
+		joinTask.submit(executor, arena);
+		joinTask.wait(executor);
+		check(countStealAttempts() == stealAttempts, "arenas", "an affinity key named a worker outside of the arena");
+	}
+
+	// tasks bound to the test thread run in pump, their continuations on the workers
+	void testMailbox(TaskFactory& factory, TaskExecuter& executor, std::uint32_t iterations)
+	{
+		ThreadMailbox mailbox(executor, "stress");
+		mailbox.bindToCurrentThread();
+		const auto owner = std::this_thread::get_id();
+
+		std::atomic<bool> isOnOwner = true;
+		std::atomic<bool> isOnWorker = true;
+		for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			auto first = factory.createTask([iteration]() { return iteration; });
+			auto onOwner = first.then(OnThread{ &mailbox }, [&](Task<std::uint32_t>& parent)
+			{
+				isOnOwner = isOnOwner && std::this_thread::get_id() == owner;
+				return parent.get() + 1;
+			});
+			auto last = onOwner.then([&](Task<std::uint32_t>& parent)
+			{
+				isOnWorker = isOnWorker && executor.getCurrentWorkerIndex() != TaskExecuter::INVALID_WORKER_INDEX;
+				return parent.get() + 1;
+			});
+
+			first.submit(executor);
+			while (!last.isFinished())
+			{
+				if (mailbox.pump() == 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			check(last.get() == iteration + 2, "mailbox", "wrong result");
+		}
+
+		check(isOnOwner, "mailbox", "a mailbox task has run on another thread");
+		check(isOnWorker, "mailbox", "a continuation of a mailbox task has not run on a worker");
+	}
+
+	// every finished group is written to the capture file and read back unchanged
+	void testGraphCapture(std::mt19937& random, std::uint32_t iterations)
+	{
+		const auto path = (std::filesystem::temp_directory_path() / "job_system_stress.capture").string();
+		const std::uint32_t graphCount = std::min<std::uint32_t>(iterations, 20);
+
+		std::vector<CapturedGraph> expected(graphCount);
+		{
+			GraphRecorder recorder(path);
+			check(recorder.isOpen(), "graph capture", "can not open the capture file");
+
+			TaskFactory factory;
+			factory.setGraphRecorder(&recorder);
+			{
+				TaskExecuter executor(2);
+				for (auto& graph : expected)
+				{
+					const std::uint32_t nodeCount = 1 + random() % 50;
+					auto& group = factory.createTaskGroup();
+					for (std::uint32_t node = 0; node < nodeCount; ++node)
+					{
+						group.addNode([]() {});
+						if (node != 0)
+						{
+							const std::uint32_t parent = random() % node;
+							group.link(parent, node);
+							graph.edges.emplace_back(parent, node);
+						}
+					}
+
+					const auto join = group.addNode([]() {});
+					for (std::uint32_t node = 0; node < nodeCount; ++node)
+					{
+						group.link(node, join);
+						graph.edges.emplace_back(node, std::uint32_t(join));
+					}
+					graph.executionTimes.resize(nodeCount + 1);
+
+					// a group is recorded before it is released, so the file keeps the order of the groups
+					Task<void>(group.getTaskNode(join)).wait(executor);
+					check(waitForReleasedGroups(executor), "graph capture", "in-flight groups are not released");
+				}
+			}
+
+			recorder.flush();
+		}
+
+		std::vector<CapturedGraph> graphs;
+		check(readGraphCapture(path, graphs), "graph capture", "can not read the capture file");
+		check(graphs.size() == expected.size(), "graph capture", "wrong number of graphs");
+		for (size_t index = 0; index < std::min(graphs.size(), expected.size()); ++index)
+		{
+			auto edges = graphs[index].edges;
+			auto expectedEdges = expected[index].edges;
+			std::sort(edges.begin(), edges.end());
+			std::sort(expectedEdges.begin(), expectedEdges.end());
+			check(graphs[index].executionTimes.size() == expected[index].executionTimes.size(), "graph capture", "wrong node count");
+			check(edges == expectedEdges, "graph capture", "wrong edges");
+		}
+
+		std::filesystem::remove(path);
+	}
+
+#if defined(__cpp_impl_coroutine)
+	AsyncJob<std::uint64_t> sumChain(TaskFactory& factory, std::uint32_t length, std::atomic<std::uint32_t>& finishedCount)
+	{
+		std::uint64_t sum = 0;
+		for (std::uint32_t index = 0; index < length; ++index)
+		{
+			sum += co_await factory.createTask([](std::uint32_t value) { return std::uint64_t(value); }, std::uint32_t{ index });
+		}
+
+		++finishedCount;
+		co_return sum;
+	}
+
+	// jobs suspend on tasks and are resumed by workers; every other job is dropped while it runs,
+	// and the resume jobs go through the in-flight limit like any other group
+	void testCoroutines(TaskFactory& factory, TaskExecuter& executor, std::uint32_t iterations, std::uint32_t maxInFlightGroups)
+	{
+		constexpr std::uint32_t jobCount = 16;
+		constexpr std::uint32_t length = 20;
+
+		executor.setMaxInFlightGroups(maxInFlightGroups);
+
+		for (std::uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			std::atomic<std::uint32_t> finishedCount = 0;
+			std::vector<AsyncJob<std::uint64_t>> jobs;
+			for (std::uint32_t index = 0; index < jobCount; ++index)
+			{
+				auto job = sumChain(factory, length, finishedCount);
+				job.start(executor);
+				if (index % 2 == 0)
+				{
+					jobs.push_back(std::move(job));
+				}
+			}
+
+			for (auto& job : jobs)
+			{
+				check(job.get() == length * (length - 1) / 2, "coroutines", "wrong result");
+			}
+
+			// the dropped jobs still run to their end
+			while (finishedCount != jobCount)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		executor.setMaxInFlightGroups(0);
+	}
+#endif
+
+	void testAlgorithms(TaskFactory& factory, TaskExecuter& executor, std::mt19937& random)
+	{
+		std::vector<std::uint32_t> input(100000 + random() % 1000);
+		std::generate(input.begin(), input.end(), [&random]() { return random() % 1000; });
+
+		auto sorted = input;
+		parallelSort(factory, executor, sorted.begin(), sorted.end());
+		auto expectedSorted = input;
+		std::sort(expectedSorted.begin(), expectedSorted.end());
+		check(sorted == expectedSorted, "algorithms", "parallelSort");
+
+		// not contiguous and without a default constructor
+		struct Value
+		{
+			explicit Value(std::uint32_t key) : key(key) {}
+			std::uint32_t key;
+		};
+		std::deque<Value> values;
+		for (auto key : input)
+		{
+			values.emplace_back(key);
+		}
+		parallelSort(factory, executor, values.begin(), values.end(), [](const Value& lhs, const Value& rhs) { return lhs.key < rhs.key; });
+		check(std::equal(values.begin(), values.end(), expectedSorted.begin(), [](const Value& value, std::uint32_t key) { return value.key == key; }),
+			"algorithms", "parallelSort of a deque");
+
+		std::vector<std::uint64_t> expected(input.size());
+		std::vector<std::uint64_t> result(input.size());
+		std::inclusive_scan(input.begin(), input.end(), expected.begin(), std::plus<>(), std::uint64_t(0));
+		parallelInclusiveScan(factory, executor, input.begin(), input.end(), result.begin(), [](std::uint64_t lhs, std::uint64_t rhs) { return lhs + rhs; });
+		check(expected == result, "algorithms", "parallelInclusiveScan");
+
+		const auto sum = parallelTransformReduce(factory, executor, input.begin(), input.end(), std::uint64_t(0), std::plus<>(), [](std::uint32_t value) { return std::uint64_t(value); });
+		check(sum == expected.back(), "algorithms", "parallelTransformReduce");
+
+		std::exclusive_scan(input.begin(), input.end(), expected.begin(), std::uint64_t(7));
+		parallelExclusiveScan(factory, executor, input.begin(), input.end(), result.begin(), std::uint64_t(7));
+		check(expected == result, "algorithms", "parallelExclusiveScan");
+
+		// starts off a vector boundary, so the kernel sees a head, vector blocks and a tail
+		std::vector<float> source(input.begin(), input.end());
+		std::vector<float> doubled(source.size());
+		const size_t offset = 1;
+		parallelForSimd(factory, executor, source.size() - offset, [](auto block, float* out, const float* in)
+		{
+			for (size_t index = 0; index < block.length; ++index)
+			{
+				out[index] = in[index] * 2.0f;
+			}
+		}, doubled.data() + offset, static_cast<const float*>(source.data() + offset));
+
+		bool isDoubled = doubled[0] == 0.0f;
+		for (size_t index = offset; isDoubled && index < source.size(); ++index)
+		{
+			isDoubled = doubled[index] == source[index] * 2.0f;
+		}
+		check(isDoubled, "algorithms", "parallelForSimd");
+	}
+
+	// with an in-flight limit below the token count run() blocks in submit while tokens finish
+	void testPipeline(TaskFactory& factory, TaskExecuter& executor, std::uint32_t maxInFlightGroups)
+	{
+		constexpr int itemCount = 2000;
+
+		executor.setMaxInFlightGroups(maxInFlightGroups);
+
+		int next = 0;
+		std::vector<int> output;
+
+		Pipeline pipeline(8);
+		pipeline.setInput([&](std::any& item)
+		{
+			if (next == itemCount)
+			{
+				return false;
+			}
+			item = next++;
+			return true;
+		});
+		pipeline.addStage(StageMode::Parallel, [](std::any& item) { item = std::any_cast<int>(item) * 2; });
+		pipeline.addStage(StageMode::SerialInOrder, [&](std::any& item) { output.push_back(std::any_cast<int>(item)); });
+		pipeline.run(factory, executor);
+
+		bool isOrdered = output.size() == itemCount;
+		for (int index = 0; isOrdered && index < itemCount; ++index)
+		{
+			isOrdered = output[index] == index * 2;
+		}
+		check(isOrdered, "pipeline", "serial in-order stage saw items out of order");
+
+		executor.setMaxInFlightGroups(0);
+	}
+
+	void runStress(std::uint32_t iterations)
+	{
+		const auto coreCount = static_cast<std::uint16_t>(std::max(1u, std::thread::hardware_concurrency()));
+
+		std::vector<std::uint16_t> workerCounts = { 1, 2, 4, coreCount };
+		std::sort(workerCounts.begin(), workerCounts.end());
+		workerCounts.erase(std::unique(workerCounts.begin(), workerCounts.end()), workerCounts.end());
+
+		testCostEstimate();
+
+		std::mt19937 random(12345);
+		for (auto workerCount : workerCounts)
+		{
+			std::cout << "stress with " << workerCount << " workers" << std::endl;
+
+			TaskFactory factory;
+			TaskExecuter executor(workerCount);
+
+			testRandomGraphs(factory, executor, random, iterations);
+			testStreamingGraphs(factory, executor, random, iterations);
+			testNestedWaits(factory, executor, iterations);
+			testContinuationAfterWait(factory, executor, iterations);
+			testContinuationAfterSubmit(factory, executor, iterations);
+			testPoolLimit(workerCount);
+			testConcurrentSubmission(factory, executor, iterations, 0);
+			testConcurrentSubmission(factory, executor, iterations, 3);
+			testAdmissionHelping(factory, executor, iterations);
+			testMailbox(factory, executor, iterations);
+			testAlgorithms(factory, executor, random);
+			testPipeline(factory, executor, 0);
+			testPipeline(factory, executor, 2);
+#if defined(__cpp_impl_coroutine)
+			testCoroutines(factory, executor, iterations, 0);
+			testCoroutines(factory, executor, iterations, 2);
+#endif
+			testArenas(workerCount, random, iterations);
+		}
+
+		testGraphCapture(random, iterations);
+	}
+
+	// wide graphs of equally long tasks, throughput relative to one worker
+	void runSweep()
+	{
+		constexpr std::uint32_t groupCount = 32;
+		constexpr std::uint32_t taskCount = 256;
+		constexpr std::uint64_t taskDuration = 20'000;
+
+		const auto coreCount = static_cast<std::uint16_t>(std::max(1u, std::thread::hardware_concurrency()));
+
+		double baseline = 0.0;
+		for (std::uint16_t workerCount = 1; workerCount <= coreCount; ++workerCount)
+		{
+			TaskFactory factory;
+			TaskExecuter executor(workerCount);
+
+			ManualTimer timer;
+			timer.start();
+			for (std::uint32_t groupIndex = 0; groupIndex < groupCount; ++groupIndex)
+			{
+				auto& group = factory.createTaskGroup();
+				const auto join = group.addNode([]() {});
+				for (std::uint32_t index = 0; index < taskCount; ++index)
+				{
+					group.link(group.addNode(&busyWork, std::uint64_t{ taskDuration }), join);
+				}
+				Task<void>(group.getTaskNode(join)).wait(executor);
+			}
+			const auto elapsed = timer.end();
+
+			const double throughput = double(groupCount) * taskCount * 1e9 / double(elapsed);
+			if (workerCount == 1)
+			{
+				baseline = throughput;
+			}
+
+			const double speedup = throughput / baseline;
+			std::cout << workerCount << " workers: " << std::uint64_t(throughput) << " tasks/s, speedup " << speedup
+				<< ", efficiency " << 100.0 * speedup / workerCount << " %" << std::endl;
+		}
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc > 1 && std::strcmp(argv[1], "--sweep") == 0)
+	{
+		runSweep();
+		return 0;
+	}
+
+	const std::uint32_t iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+	runStress(iterations);
+
+	if (g_failureCount != 0)
+	{
+		std::cout << g_failureCount << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}